@@ -0,0 +1,356 @@
+/*
+ * Host Benchmark for Effect Renderers
+ *
+ * Renders a number of frames of every effect at matrix sizes from 8x8 to
+ * 64x64 and reports the average cost per frame and the heap allocations
+ * made while rendering. Firefly and stars are also run through the float
+ * reference renderers they were ported from, at their fixed 8x8
+ * geometry. Timings include the output stage, which is also timed on its
+ * own at a few brightness levels, and so are the pack stage, the SPI bit
+ * expansion and HSV conversion of a whole frame. The host has an FPU and
+ * fast dividers, so the gap on the ESP32-C3 is larger than the one
+ * printed here.
+ *
+ * Usage: bench_effects [frames] [--csv]
+ *
+ * frames is the count at 8x8, larger matrices run proportionally fewer
+ * so every size takes about the same time. --csv prints one line per case
+ * for scripts comparing runs. The exit status is 1 if a renderer touched
+ * the heap: the render task has no allocator in its frame path.
+ */
+
+#include "color_hsv.h"
+#include "effect_render.h"
+#include "float_reference.h"
+#include "led_output.h"
+#include "led_pack.h"
+#include "led_spi_encoder.h"
+#include "led_timing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLE_COUNTER 1
+static inline uint64_t read_cycles(void) { return __rdtsc(); }
+#else
+#define HAVE_CYCLE_COUNTER 0
+static inline uint64_t read_cycles(void) { return 0; }
+#endif
+
+// Heap calls are routed through here by the linker (--wrap), see
+// CMakeLists.txt. Calls from inside the C library are not counted.
+#ifndef BENCH_COUNT_ALLOCS
+#define BENCH_COUNT_ALLOCS 0
+#endif
+
+#if BENCH_COUNT_ALLOCS
+static uint32_t alloc_count;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  alloc_count++;
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+  alloc_count++;
+  return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  alloc_count++;
+  return __real_realloc(ptr, size);
+}
+
+static inline uint32_t read_allocs(void) { return alloc_count; }
+#else
+static inline uint32_t read_allocs(void) { return 0; }
+#endif
+
+typedef struct {
+  const char *name;
+  effect_state_size_fn_t state_size;
+  effect_init_fn_t init;
+  effect_render_fn_t render;
+  bool reference; // Float port at 8x8, scales brightness itself
+} bench_case_t;
+
+static const bench_case_t cases[] = {
+    {"soft_light", NULL, NULL, soft_light_render_frame, false},
+    {"fire", fire_state_size, fire_init, fire_render_frame, false},
+    {"firefly", firefly_state_size, firefly_init, firefly_render_frame,
+     false},
+    {"firefly_float", NULL, float_firefly_init, float_firefly_render_frame,
+     true},
+    {"stars", stars_state_size, stars_init, stars_render_frame, false},
+    {"stars_float", NULL, float_stars_init, float_stars_render_frame, true},
+    {"rainbow", NULL, NULL, rainbow_render_frame, false},
+};
+
+static const uint16_t sizes[][2] = {{8, 8}, {16, 16}, {32, 32}, {64, 64}};
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Cost of a run of frames
+typedef struct {
+  uint64_t ns;
+  uint64_t cycles;
+  uint32_t allocs;
+} bench_run_t;
+
+static bool csv;
+
+static void run_start(bench_run_t *run) {
+  run->allocs = read_allocs();
+  run->cycles = read_cycles();
+  run->ns = now_ns();
+}
+
+static void run_stop(bench_run_t *run) {
+  run->ns = now_ns() - run->ns;
+  run->cycles = read_cycles() - run->cycles;
+  run->allocs = read_allocs() - run->allocs;
+}
+
+static void print_header(void) {
+  if (csv) {
+    printf("case,width,height,frames,ns_per_frame,cycles_per_frame,"
+           "allocs\n");
+    return;
+  }
+  printf("%-14s %7s %12s %14s %7s\n", "case", "size", "ns/frame",
+         HAVE_CYCLE_COUNTER ? "cycles/frame" : "",
+         BENCH_COUNT_ALLOCS ? "allocs" : "");
+}
+
+static void report(const char *name, uint16_t width, uint16_t height,
+                   uint32_t frames, const bench_run_t *run) {
+  double ns = (double)run->ns / frames;
+  double cycles = (double)run->cycles / frames;
+
+  // Columns the platform cannot measure stay empty
+  if (csv) {
+    printf("%s,%u,%u,%u,%.1f,", name, width, height, frames, ns);
+    if (HAVE_CYCLE_COUNTER) {
+      printf("%.0f", cycles);
+    }
+    printf(",");
+    if (BENCH_COUNT_ALLOCS) {
+      printf("%u", run->allocs);
+    }
+    printf("\n");
+    return;
+  }
+
+  char size[16];
+  snprintf(size, sizeof(size), "%ux%u", width, height);
+  printf("%-14s %7s %12.1f", name, size, ns);
+  if (HAVE_CYCLE_COUNTER) {
+    printf(" %14.0f", cycles);
+  }
+  if (BENCH_COUNT_ALLOCS) {
+    printf(" %7u", run->allocs);
+  }
+  printf("\n");
+}
+
+int main(int argc, char **argv) {
+  uint32_t frames = 20000;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--csv") == 0) {
+      csv = true;
+    } else {
+      frames = (uint32_t)strtoul(argv[i], NULL, 10);
+    }
+  }
+  if (frames == 0) {
+    fprintf(stderr, "usage: %s [frames] [--csv]\n", argv[0]);
+    return 2;
+  }
+
+  // Same geometry as the reference renderers
+  enum { LED_COUNT = FLOAT_REFERENCE_WIDTH * FLOAT_REFERENCE_HEIGHT };
+  static uint8_t pixels[LED_COUNT * 3];
+  static uint8_t residual[sizeof(pixels)];
+  static uint16_t tables[LED_COUNT];
+  render_geometry_t geometry = {.width = FLOAT_REFERENCE_WIDTH,
+                                .height = FLOAT_REFERENCE_HEIGHT};
+  render_frame_t frame = {.pixels = pixels, .geometry = &geometry};
+  led_output_t output;
+  uint32_t checksum = 0;
+  uint32_t render_allocs = 0;
+
+  print_header();
+
+  // Every effect at every size, buffers are allocated outside the timing
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    render_geometry_t size_geometry = {.width = sizes[s][0],
+                                       .height = sizes[s][1]};
+    uint8_t *size_tables = malloc(render_tables_size(&size_geometry));
+    render_init(&size_geometry, size_tables);
+    size_t len = size_geometry.count * 3;
+    uint8_t *size_pixels = malloc(len);
+    uint8_t *size_residual = malloc(len);
+    led_output_t size_output;
+    led_output_init(&size_output, size_residual, len);
+    led_output_set_brightness(&size_output, 128);
+    render_frame_t size_frame = {.pixels = size_pixels,
+                                 .geometry = &size_geometry};
+    uint32_t size_frames = frames * LED_COUNT / size_geometry.count;
+    if (size_frames == 0) {
+      size_frames = 1;
+    }
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+      const bench_case_t *bench = &cases[c];
+      bool reference_size = size_geometry.width == FLOAT_REFERENCE_WIDTH &&
+                            size_geometry.height == FLOAT_REFERENCE_HEIGHT;
+      if (bench->reference && !reference_size) {
+        continue;
+      }
+      size_t state_size = bench->reference ? FLOAT_REFERENCE_STATE_SIZE
+                          : bench->state_size
+                              ? bench->state_size(&size_geometry)
+                              : 0;
+      void *state = malloc(state_size ? state_size : 1);
+      // Same random sequence for every case, runs stay comparable
+      render_random_seed(0);
+      if (bench->init) {
+        bench->init(state, &size_geometry);
+      }
+
+      bench_run_t run;
+      run_start(&run);
+      for (uint32_t t = 0; t < size_frames; t++) {
+        bench->render(state, t, &size_frame);
+        if (!bench->reference) {
+          led_output_apply(&size_output, size_pixels, len);
+        }
+        checksum += size_pixels[t % len];
+      }
+      run_stop(&run);
+
+      report(bench->name, size_geometry.width, size_geometry.height,
+             size_frames, &run);
+      render_allocs += run.allocs;
+      free(state);
+    }
+
+    free(size_pixels);
+    free(size_residual);
+    free(size_tables);
+  }
+
+  render_init(&geometry, tables);
+  led_output_init(&output, residual, sizeof(residual));
+
+  // Output stage alone, at the dim levels the encoder steps through. The
+  // frame is processed in place over and over, fine since the cost does
+  // not depend on the content or the level.
+  static const uint8_t levels[] = {10, 30, 128, 255};
+  for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+    led_output_set_brightness(&output, levels[l]);
+    soft_light_render_frame(NULL, 0, &frame);
+
+    bench_run_t run;
+    run_start(&run);
+    for (uint32_t t = 0; t < frames; t++) {
+      led_output_apply(&output, pixels, sizeof(pixels));
+      checksum += pixels[t % sizeof(pixels)];
+    }
+    run_stop(&run);
+
+    char name[16];
+    snprintf(name, sizeof(name), "output@%u", levels[l]);
+    report(name, geometry.width, geometry.height, frames, &run);
+  }
+
+  // Pack stage, progressive and serpentine wiring
+  static uint8_t wire[LED_COUNT * LED_PACK_MAX_BYTES_PER_PIXEL];
+  static uint16_t map[LED_COUNT];
+  led_layout_t layout = {.serpentine = true};
+  led_pack_build_map(&layout, geometry.width, geometry.height, map);
+  for (int mapped = 0; mapped < 2; mapped++) {
+    bench_run_t run;
+    run_start(&run);
+    for (uint32_t t = 0; t < frames; t++) {
+      pixels[t % sizeof(pixels)]++;
+      led_pack(LED_PIXEL_GRB, pixels, wire, LED_COUNT, mapped ? map : NULL);
+      checksum += wire[t % sizeof(wire)];
+    }
+    run_stop(&run);
+
+    report(mapped ? "pack_mapped" : "pack", geometry.width, geometry.height,
+           frames, &run);
+  }
+
+  // Bit expansion of a GRB frame for the SPI transport
+  const uint16_t reset_us =
+      led_timing_reset_us(led_timing_get(LED_CHIP_WS2812B), false);
+  uint8_t *spi_stream = malloc(
+      led_spi_frame_size(LED_SPI_BITS_4, LED_COUNT * 3, reset_us));
+  for (int bits = LED_SPI_BITS_3; bits <= LED_SPI_BITS_4; bits++) {
+    bench_run_t run;
+    run_start(&run);
+    for (uint32_t t = 0; t < frames; t++) {
+      wire[t % (LED_COUNT * 3)]++;
+      size_t size = led_spi_encode((led_spi_bits_t)bits, wire, LED_COUNT * 3,
+                                   reset_us, spi_stream);
+      checksum += spi_stream[t % size];
+    }
+    run_stop(&run);
+
+    report(bits == LED_SPI_BITS_3 ? "spi3" : "spi4", geometry.width,
+           geometry.height, frames, &run);
+  }
+  free(spi_stream);
+
+  // HSV conversion of one frame worth of colors, legacy vs 8-bit kernel
+  static hsv8_t colors[LED_COUNT];
+  for (int i = 0; i < LED_COUNT; i++) {
+    colors[i] = (hsv8_t){(uint8_t)(i * 4), (uint8_t)(255 - i), 200};
+  }
+  for (int kernel = 0; kernel < 2; kernel++) {
+    bench_run_t run;
+    run_start(&run);
+    for (uint32_t t = 0; t < frames; t++) {
+      colors[t % LED_COUNT].h++;
+      if (kernel == 0) {
+        for (int i = 0; i < LED_COUNT; i++) {
+          uint32_t r, g, b;
+          // Same colors in the legacy units: degrees and percent
+          legacy_hsv2rgb(colors[i].h * 360 / 256, colors[i].s * 100 / 255,
+                         colors[i].v * 100 / 255, &r, &g, &b);
+          pixels[i * 3 + 0] = r;
+          pixels[i * 3 + 1] = g;
+          pixels[i * 3 + 2] = b;
+        }
+      } else {
+        hsv8_row_to_pixels(colors, pixels, LED_COUNT);
+      }
+      checksum += pixels[t % sizeof(pixels)];
+    }
+    run_stop(&run);
+
+    report(kernel == 0 ? "hsv_legacy" : "hsv8_row", geometry.width,
+           geometry.height, frames, &run);
+  }
+
+  // Keeps the compiler from dropping the rendered frames
+  fprintf(csv ? stderr : stdout, "checksum %u\n", checksum);
+  if (render_allocs) {
+    fprintf(stderr, "renderers allocated %u times\n", render_allocs);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,393 @@
+/*
+ * Float Reference Renderers
+ *
+ * The firefly and stars effects as they were before the fixed-point port,
+ * including the sqrtf/powf corner mask and the per-pixel brightness
+ * scaling. Only used by the host benchmark to
+ * compare per-frame cost.
+ */
+
+#include "float_reference.h"
+#include <math.h>
+#include <string.h>
+
+// The reference renderers still apply brightness per pixel and only know
+// the compile-time 8x8 matrix they were written for
+#define FLOAT_REFERENCE_BRIGHTNESS 128
+#define LED_NUMBERS_COL FLOAT_REFERENCE_WIDTH
+#define LED_NUMBERS_ROW FLOAT_REFERENCE_HEIGHT
+#define LED_NUMBERS (LED_NUMBERS_COL * LED_NUMBERS_ROW)
+#define STARS_MAX (LED_NUMBERS / 4)
+
+typedef struct {
+  float size_phase;
+  float movement_phase;
+  float random_flicker_timer;
+  float next_random_flicker;
+  bool is_random_dim;
+  float flicker_phase;
+  float flicker_variation_phase;
+  float micro_flicker_phase;
+} float_firefly_state_t;
+
+typedef struct {
+  int position;            // LED index
+  float brightness;        // Current brightness (0.0 - 1.0)
+  float target_brightness; // Target brightness
+  float fade_speed;        // How fast it fades
+  bool active;             // Is this star active
+  uint8_t color_type;      // 0=cool white, 1=warm white, 2=blue-white
+  float timer;             // For timing control
+  float next_change;       // When to change state
+} float_star_t;
+
+typedef struct {
+  float_star_t stars[STARS_MAX];
+} float_stars_state_t;
+
+// Function to check if LED should be disabled for circular rounding
+static bool is_corner_led(int led_index, float threshold) {
+  // Calculate row and column position in the matrix
+  int row = led_index / LED_NUMBERS_COL;
+  int col = led_index % LED_NUMBERS_COL;
+
+  // Calculate distance from center for each LED
+  float center_x = (LED_NUMBERS_COL - 1) / 2.0f;
+  float center_y = (LED_NUMBERS_ROW - 1) / 2.0f;
+
+  float distance = sqrtf(powf(col - center_x, 2) + powf(row - center_y, 2));
+  float max_radius = sqrtf(powf(center_x, 2) + powf(center_y, 2));
+
+  return distance > max_radius * threshold;
+}
+
+// Corner rounding threshold grows from start to target in fixed steps
+static float ramp_threshold(uint32_t t, float start, float target,
+                            float step) {
+  float threshold = start + step * (float)(t + 1);
+  return threshold > target ? target : threshold;
+}
+
+static inline void set_pixel(render_frame_t *frame, int i, uint32_t red,
+                             uint32_t green, uint32_t blue) {
+  frame->pixels[i * 3 + 0] = red;
+  frame->pixels[i * 3 + 1] = green;
+  frame->pixels[i * 3 + 2] = blue;
+}
+
+void legacy_hsv2rgb(uint32_t h, uint32_t s, uint32_t v, uint32_t *r,
+                    uint32_t *g, uint32_t *b) {
+  h %= 360; // h -> [0,360]
+  uint32_t rgb_max = (v * 255) / 100;
+  uint32_t rgb_min = (rgb_max * (100 - s)) / 100;
+
+  uint32_t i = h / 60;
+  uint32_t diff = h % 60;
+
+  // RGB adjustment amount by hue
+  uint32_t rgb_adj = (rgb_max - rgb_min) * diff / 60;
+
+  switch (i) {
+  case 0:
+    *r = rgb_max;
+    *g = rgb_min + rgb_adj;
+    *b = rgb_min;
+    break;
+  case 1:
+    *r = rgb_max - rgb_adj;
+    *g = rgb_max;
+    *b = rgb_min;
+    break;
+  case 2:
+    *r = rgb_min;
+    *g = rgb_max;
+    *b = rgb_min + rgb_adj;
+    break;
+  case 3:
+    *r = rgb_min;
+    *g = rgb_max - rgb_adj;
+    *b = rgb_max;
+    break;
+  case 4:
+    *r = rgb_min + rgb_adj;
+    *g = rgb_min;
+    *b = rgb_max;
+    break;
+  default:
+    *r = rgb_max;
+    *g = rgb_min;
+    *b = rgb_max - rgb_adj;
+    break;
+  }
+}
+
+// Цвета: черный фон, желтый светлячек
+#define FIREFLY_HUE 20
+#define FIREFLY_SATURATION 100
+#define FIREFLY_MAX_BRIGHTNESS 100
+
+static const float random_flicker_interval_min = 0.5f;
+static const float random_flicker_interval_max = 3.0f;
+
+void float_firefly_init(void *state, const render_geometry_t *geometry) {
+  float_firefly_state_t *s = (float_firefly_state_t *)state;
+  (void)geometry;
+  memset(s, 0, sizeof(*s));
+  s->next_random_flicker = random_flicker_interval_min;
+}
+
+void float_firefly_render_frame(void *state, uint32_t t, render_frame_t *frame) {
+  float_firefly_state_t *s = (float_firefly_state_t *)state;
+  uint32_t red, green, blue;
+  (void)t;
+
+  const float firefly_size_min = 1.5f; // минимальный размер
+  const float firefly_size_max = 3.5f; // максимальный размер
+  const float size_change_speed = 0.03f; // скорость изменения размера
+  const float movement_speed = 0.05f;
+  const float center_x = (LED_NUMBERS_COL - 1) / 2.0f;
+  const float center_y = (LED_NUMBERS_ROW - 1) / 2.0f;
+  const float figure8_width = LED_NUMBERS_COL * 0.8f;
+  const float figure8_height = LED_NUMBERS_ROW * 0.8f;
+  // Медленнее чем основное мерцание
+  const float flicker_variation_speed = 0.014f;
+  const float micro_flicker_speed = 0.8f;   // Быстрые микро-мерцания
+  const float micro_flicker_amount = 0.15f; // Интенсивность микро-мерцаний
+
+  // Обновляем фазу движения
+  s->movement_phase += movement_speed;
+  if (s->movement_phase > 2 * M_PI) {
+    s->movement_phase -= 2 * M_PI;
+  }
+
+  // Обновляем фазу изменения размера
+  s->size_phase += size_change_speed;
+  if (s->size_phase > 2 * M_PI) {
+    s->size_phase -= 2 * M_PI;
+  }
+
+  float firefly_size = ((firefly_size_max - firefly_size_min) / 2) *
+                           (sin(s->size_phase) + 1.0f) +
+                       firefly_size_min;
+
+  // Обновляем случайное мерцание
+  s->random_flicker_timer += 0.02f;
+  if (s->random_flicker_timer >= s->next_random_flicker) {
+    s->random_flicker_timer = 0.0f;
+    s->is_random_dim = !s->is_random_dim;
+
+    // Следующий интервал мерцания случайный
+    float random_factor = (float)render_random() / UINT32_MAX;
+    s->next_random_flicker =
+        random_flicker_interval_min +
+        random_factor *
+            (random_flicker_interval_max - random_flicker_interval_min);
+  }
+
+  s->flicker_variation_phase += flicker_variation_speed;
+  if (s->flicker_variation_phase > 2 * M_PI) {
+    s->flicker_variation_phase -= 2 * M_PI;
+  }
+  float flicker_variation =
+      (sin(s->flicker_variation_phase) + 1.0f) / 2.0f; // 0.0 - 1.0
+  float flicker_speed = 0.1f + flicker_variation * 0.2f; // 0.1 - 0.3
+
+  s->micro_flicker_phase += micro_flicker_speed;
+  if (s->micro_flicker_phase > 2 * M_PI) {
+    s->micro_flicker_phase -= 2 * M_PI;
+  }
+  float micro_flicker = sin(s->micro_flicker_phase) * micro_flicker_amount;
+
+  // Восьмерка - единственный режим движения
+  float firefly_x = center_x + (figure8_width / 2) * sin(s->movement_phase);
+  float firefly_y = center_y + (figure8_height / 2) * sin(s->movement_phase) *
+                                   cos(s->movement_phase);
+
+  // Обновляем мерцание
+  s->flicker_phase += flicker_speed;
+  if (s->flicker_phase >= M_PI * 2) {
+    s->flicker_phase = 0;
+  }
+
+  // Яркость светлячка с мерцанием
+  float flicker = (sin(s->flicker_phase) + 1.0f) / 2.0f;
+
+  // Добавляем микро-мерцания для большей естественности
+  flicker += micro_flicker;
+  if (flicker < 0.3f)
+    flicker = 0.3f; // Минимальная яркость
+  if (flicker > 1.0f)
+    flicker = 1.0f; // Максимальная яркость
+
+  if (s->is_random_dim) {
+    flicker *= 0.5f; // Dim by 50% during random flickering
+  }
+
+  uint8_t firefly_brightness = (uint8_t)(FIREFLY_MAX_BRIGHTNESS * flicker);
+
+  const float threshold = 0.95f;
+
+  for (int j = 0; j < LED_NUMBERS; j++) {
+    if (is_corner_led(j, threshold)) {
+      // Отключаем угловые светодиоды
+      set_pixel(frame, j, 0, 0, 0);
+      continue;
+    }
+
+    // Переводим 1D индекс в 2D координаты
+    int row = j / LED_NUMBERS_COL;
+    int col = j % LED_NUMBERS_COL;
+
+    // Рассчитываем расстояние в 2D
+    float distance = sqrtf(powf(col - firefly_x, 2) + powf(row - firefly_y, 2));
+
+    if (distance <= firefly_size) {
+      // Светлячек - плавное затухание от центра
+      float intensity = 1.0f - (distance / firefly_size);
+      intensity = intensity * intensity; // квадратичное затухание
+
+      uint8_t brightness = (uint8_t)(firefly_brightness * intensity);
+      legacy_hsv2rgb(FIREFLY_HUE, FIREFLY_SATURATION, brightness, &red, &green,
+                     &blue);
+    } else {
+      // Фон - черный
+      red = 0;
+      green = 0;
+      blue = 0;
+    }
+
+    // Применяем общую яркость
+    red = (red * FLOAT_REFERENCE_BRIGHTNESS) / 255;
+    green = (green * FLOAT_REFERENCE_BRIGHTNESS) / 255;
+    blue = (blue * FLOAT_REFERENCE_BRIGHTNESS) / 255;
+
+    set_pixel(frame, j, red, green, blue);
+  }
+}
+
+void float_stars_init(void *state, const render_geometry_t *geometry) {
+  float_stars_state_t *s = (float_stars_state_t *)state;
+  (void)geometry;
+
+  for (int i = 0; i < STARS_MAX; i++) {
+    float_star_t *star = &s->stars[i];
+    star->position = render_random() % LED_NUMBERS;
+    star->brightness = 0.0f;
+    star->target_brightness = 0.0f;
+    star->fade_speed =
+        0.01f + (float)(render_random() % 30) / 1000.0f; // 0.01-0.04
+    star->active = false;
+    star->color_type = render_random() % 3;
+    star->timer = 0.0f;
+    star->next_change =
+        (float)(render_random() % 3000) / 1000.0f; // 0-3 seconds
+  }
+}
+
+void float_stars_render_frame(void *state, uint32_t t, render_frame_t *frame) {
+  float_stars_state_t *s = (float_stars_state_t *)state;
+  uint32_t red, green, blue;
+  // Gradually increase corner rounding threshold
+  float threshold =
+      ramp_threshold(t, 0.1f, 0.95f, (0.95f - 0.1f) / (100 / 5));
+
+  // Update stars
+  for (int i = 0; i < STARS_MAX; i++) {
+    float_star_t *star = &s->stars[i];
+    star->timer += 0.05f;
+
+    // Check if it's time to change star state
+    if (star->timer >= star->next_change) {
+      star->timer = 0.0f;
+
+      if (star->active && star->target_brightness > 0.1f) {
+        // Start fading out
+        star->target_brightness = 0.0f;
+        star->next_change =
+            1.0f + (float)(render_random() % 2000) / 1000.0f; // 1-3s
+      } else if (render_random() % 100 < 15) { // 15% chance to activate
+        star->active = true;
+        star->position = render_random() % LED_NUMBERS;
+        star->target_brightness =
+            0.3f + (float)(render_random() % 70) / 100.0f; // 0.3-1.0
+        star->color_type = render_random() % 3;
+        star->fade_speed =
+            0.008f + (float)(render_random() % 25) / 1000.0f; // 0.008-0.033
+        star->next_change =
+            2.0f + (float)(render_random() % 4000) / 1000.0f; // 2-6s
+      } else {
+        star->next_change =
+            0.5f + (float)(render_random() % 1500) / 1000.0f; // 0.5-2s
+      }
+    }
+
+    // Update brightness towards target
+    if (star->brightness < star->target_brightness) {
+      star->brightness += star->fade_speed;
+      if (star->brightness > star->target_brightness) {
+        star->brightness = star->target_brightness;
+      }
+    } else if (star->brightness > star->target_brightness) {
+      star->brightness -= star->fade_speed;
+      if (star->brightness < star->target_brightness) {
+        star->brightness = star->target_brightness;
+      }
+    }
+
+    // Deactivate completely faded stars
+    if (star->brightness <= 0.01f) {
+      star->active = false;
+      star->brightness = 0.0f;
+    }
+  }
+
+  // Clear all LEDs to black background
+  render_clear(frame);
+
+  // Render active stars
+  for (int i = 0; i < STARS_MAX; i++) {
+    const float_star_t *star = &s->stars[i];
+    if (!star->active || star->brightness <= 0.01f) {
+      continue;
+    }
+
+    int pos = star->position;
+
+    if (is_corner_led(pos, threshold)) {
+      continue; // Skip corner LEDs
+    }
+
+    // Set star color based on type
+    uint8_t base_brightness = (uint8_t)(255 * star->brightness);
+
+    switch (star->color_type) {
+    case 0: // Cool white
+      red = base_brightness;
+      green = base_brightness;
+      blue = (uint32_t)(base_brightness * 1.2f);
+      if (blue > 255)
+        blue = 255;
+      break;
+    case 1: // Warm white
+      red = base_brightness;
+      green = (uint8_t)(base_brightness * 0.8f);
+      blue = (uint8_t)(base_brightness * 0.4f);
+      break;
+    case 2: // Blue-white
+      red = (uint8_t)(base_brightness * 0.8f);
+      green = (uint8_t)(base_brightness * 0.9f);
+      blue = base_brightness;
+      break;
+    default:
+      red = green = blue = base_brightness;
+      break;
+    }
+
+    // Apply global brightness
+    red = (red * FLOAT_REFERENCE_BRIGHTNESS) / 255;
+    green = (green * FLOAT_REFERENCE_BRIGHTNESS) / 255;
+    blue = (blue * FLOAT_REFERENCE_BRIGHTNESS) / 255;
+
+    set_pixel(frame, pos, red, green, blue);
+  }
+}
@@ -0,0 +1,29 @@
+/*
+ * Float Reference Renderers
+ */
+
+#ifndef FLOAT_REFERENCE_H
+#define FLOAT_REFERENCE_H
+
+#include "effect_render.h"
+
+// Large enough for the state of any reference renderer
+#define FLOAT_REFERENCE_STATE_SIZE 1024
+
+// Matrix the reference renderers draw, frames must use this geometry
+#define FLOAT_REFERENCE_WIDTH 8
+#define FLOAT_REFERENCE_HEIGHT 8
+
+// HSV conversion the effects used before color_hsv: hue in degrees,
+// saturation and value in percent
+void legacy_hsv2rgb(uint32_t h, uint32_t s, uint32_t v, uint32_t *r,
+                    uint32_t *g, uint32_t *b);
+
+void float_firefly_init(void *state, const render_geometry_t *geometry);
+void float_firefly_render_frame(void *state, uint32_t t,
+                                render_frame_t *frame);
+
+void float_stars_init(void *state, const render_geometry_t *geometry);
+void float_stars_render_frame(void *state, uint32_t t, render_frame_t *frame);
+
+#endif // FLOAT_REFERENCE_H
@@ -0,0 +1,807 @@
+/*
+ * Host Tests for the Hardware Independent Modules
+ *
+ * Plain C checks, no framework: every failed check is printed and the
+ * exit status is the number of failed tests. Run with ctest or directly.
+ */
+
+#include "color_hsv.h"
+#include "control_store.h"
+#include "effect_registry.h"
+#include "effect_render.h"
+#include "float_reference.h"
+#include "frame_clock.h"
+#include "frame_metrics.h"
+#include "led_output.h"
+#include "led_pack.h"
+#include "led_spi_encoder.h"
+#include "led_timing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failed_checks;
+
+#define CHECK(cond, ...)                                                       \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("  %s:%d: ", __FILE__, __LINE__);                                 \
+      printf(__VA_ARGS__);                                                     \
+      printf("\n");                                                            \
+      failed_checks++;                                                         \
+    }                                                                          \
+  } while (0)
+
+// 8-bit hue has 1.4 degree steps, that alone moves a full scale channel
+// by up to 6 levels inside a 60 degree sector
+#define HSV_TOLERANCE 6
+
+static void test_hsv_matches_legacy(void) {
+  int worst = 0;
+
+  for (uint32_t h = 0; h < 360; h++) {
+    for (uint32_t s = 0; s <= 100; s += 5) {
+      for (uint32_t v = 0; v <= 100; v += 5) {
+        uint32_t lr, lg, lb;
+        uint8_t r, g, b;
+        legacy_hsv2rgb(h, s, v, &lr, &lg, &lb);
+        hsv8_t color = {HSV8_HUE_DEG(h), HSV8_PERCENT(s), HSV8_PERCENT(v)};
+        hsv8_to_rgb(color, &r, &g, &b);
+
+        int diff = abs((int)lr - r);
+        diff = abs((int)lg - g) > diff ? abs((int)lg - g) : diff;
+        diff = abs((int)lb - b) > diff ? abs((int)lb - b) : diff;
+        if (diff > worst) {
+          worst = diff;
+        }
+        CHECK(diff <= HSV_TOLERANCE,
+              "hsv(%u, %u, %u): %u/%u/%u, legacy %u/%u/%u", (unsigned)h,
+              (unsigned)s, (unsigned)v, r, g, b, (unsigned)lr, (unsigned)lg,
+              (unsigned)lb);
+      }
+    }
+  }
+  printf("  worst channel difference %d\n", worst);
+}
+
+static void test_hsv_primaries(void) {
+  uint8_t r, g, b;
+
+  hsv8_to_rgb((hsv8_t){0, 255, 255}, &r, &g, &b);
+  CHECK(r == 255 && g == 0 && b == 0, "red: %u/%u/%u", r, g, b);
+  hsv8_to_rgb((hsv8_t){0, 0, 200}, &r, &g, &b);
+  CHECK(r == 200 && g == 200 && b == 200, "grey: %u/%u/%u", r, g, b);
+  hsv8_to_rgb((hsv8_t){128, 255, 0}, &r, &g, &b);
+  CHECK(r == 0 && g == 0 && b == 0, "black: %u/%u/%u", r, g, b);
+}
+
+static void test_hsv_row_matches_single(void) {
+  hsv8_t row[16];
+  uint8_t pixels[sizeof(row) / sizeof(row[0]) * 3];
+
+  for (size_t i = 0; i < 16; i++) {
+    row[i] = (hsv8_t){(uint8_t)(i * 17), (uint8_t)(255 - i * 5),
+                      (uint8_t)(i * 16)};
+  }
+  hsv8_row_to_pixels(row, pixels, 16);
+  for (size_t i = 0; i < 16; i++) {
+    uint8_t r, g, b;
+    hsv8_to_rgb(row[i], &r, &g, &b);
+    CHECK(pixels[i * 3] == r && pixels[i * 3 + 1] == g &&
+              pixels[i * 3 + 2] == b,
+          "row pixel %u", (unsigned)i);
+  }
+}
+
+static void test_pack_color_orders(void) {
+  const uint8_t rgb[] = {10, 20, 30, 200, 100, 50};
+  uint8_t wire[2 * LED_PACK_MAX_BYTES_PER_PIXEL];
+  size_t len;
+
+  len = led_pack(LED_PIXEL_GRB, rgb, wire, 2, NULL);
+  CHECK(len == 6 && wire[0] == 20 && wire[1] == 10 && wire[2] == 30 &&
+            wire[3] == 100 && wire[4] == 200 && wire[5] == 50,
+        "GRB");
+  len = led_pack(LED_PIXEL_RGB, rgb, wire, 2, NULL);
+  CHECK(len == 6 && memcmp(wire, rgb, 6) == 0, "RGB");
+  len = led_pack(LED_PIXEL_BGR, rgb, wire, 2, NULL);
+  CHECK(len == 6 && wire[0] == 30 && wire[1] == 20 && wire[2] == 10, "BGR");
+
+  // White takes the part common to all channels
+  len = led_pack(LED_PIXEL_GRBW, rgb, wire, 2, NULL);
+  CHECK(len == 8 && wire[0] == 10 && wire[1] == 0 && wire[2] == 20 &&
+            wire[3] == 10,
+        "GRBW pixel 0: %u %u %u %u", wire[0], wire[1], wire[2], wire[3]);
+  CHECK(wire[4] == 50 && wire[5] == 150 && wire[6] == 0 && wire[7] == 50,
+        "GRBW pixel 1: %u %u %u %u", wire[4], wire[5], wire[6], wire[7]);
+}
+
+static void test_pack_map_layouts(void) {
+  uint16_t map[8];
+
+  // 4x2 serpentine: second row runs backwards
+  led_layout_t layout = {.serpentine = true};
+  const uint16_t serpentine[] = {0, 1, 2, 3, 7, 6, 5, 4};
+  CHECK(led_pack_build_map(&layout, 4, 2, map), "serpentine");
+  CHECK(memcmp(map, serpentine, sizeof(serpentine)) == 0, "serpentine map");
+
+  // 4x2 matrix on a 2x4 panel turned clockwise: the first matrix row is
+  // the last panel column
+  layout = (led_layout_t){.rotation = 90};
+  const uint16_t rotated[] = {1, 3, 5, 7, 0, 2, 4, 6};
+  CHECK(led_pack_build_map(&layout, 4, 2, map), "rotation 90");
+  CHECK(memcmp(map, rotated, sizeof(rotated)) == 0, "rotation 90 map");
+
+  layout = (led_layout_t){.rotation = 180};
+  const uint16_t half_turn[] = {7, 6, 5, 4, 3, 2, 1, 0};
+  CHECK(led_pack_build_map(&layout, 4, 2, map), "rotation 180");
+  CHECK(memcmp(map, half_turn, sizeof(half_turn)) == 0, "rotation 180 map");
+
+  layout = (led_layout_t){.flip_x = true};
+  const uint16_t mirrored[] = {3, 2, 1, 0, 7, 6, 5, 4};
+  CHECK(led_pack_build_map(&layout, 4, 2, map), "flip x");
+  CHECK(memcmp(map, mirrored, sizeof(mirrored)) == 0, "flip x map");
+
+  layout = (led_layout_t){.rotation = 45};
+  CHECK(!led_pack_build_map(&layout, 4, 2, map), "rotation 45");
+
+  // Every combination must stay a permutation
+  for (int bits = 0; bits < 32; bits++) {
+    layout = (led_layout_t){.serpentine = bits & 1,
+                            .rotation = ((bits >> 1) & 3) * 90,
+                            .flip_x = (bits >> 3) & 1,
+                            .flip_y = (bits >> 4) & 1};
+    uint16_t big[15 * 7];
+    led_pack_build_map(&layout, 15, 7, big);
+    CHECK(led_pack_map_valid(big, 15 * 7), "layout %d", bits);
+  }
+
+  const uint16_t duplicate[] = {0, 1, 1, 3};
+  const uint16_t out_of_range[] = {0, 1, 2, 4};
+  CHECK(!led_pack_map_valid(duplicate, 4), "duplicate entry");
+  CHECK(!led_pack_map_valid(out_of_range, 4), "entry out of range");
+}
+
+static void test_pack_scatters_by_map(void) {
+  const uint8_t rgb[] = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+  const uint16_t map[] = {2, 0, 1};
+  uint8_t wire[9];
+
+  led_pack(LED_PIXEL_RGB, rgb, wire, 3, map);
+  const uint8_t expected[] = {4, 5, 6, 7, 8, 9, 1, 2, 3};
+  CHECK(memcmp(wire, expected, sizeof(expected)) == 0, "mapped pack");
+}
+
+static void test_pack_split(void) {
+  static const uint16_t counts[] = {1, 2, 7, 64, 255, 1024};
+  led_segment_t segments[4];
+
+  for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+    for (uint8_t channels = 1; channels <= 4; channels++) {
+      if (channels > counts[c]) {
+        continue;
+      }
+      led_pack_split(counts[c], channels, segments);
+      // Consecutive runs that cover the strip and differ by at most one LED
+      uint16_t next = 0;
+      for (uint8_t i = 0; i < channels; i++) {
+        CHECK(segments[i].first == next, "%u LEDs on %u channels, segment %u",
+              counts[c], channels, i);
+        CHECK(segments[i].count >= segments[channels - 1].count &&
+                  segments[i].count - segments[channels - 1].count <= 1,
+              "%u LEDs on %u channels, balance", counts[c], channels);
+        next += segments[i].count;
+      }
+      CHECK(next == counts[c], "%u LEDs on %u channels, total", counts[c],
+            channels);
+    }
+  }
+}
+
+static void test_pack_format_names(void) {
+  for (int i = 0; i < LED_PIXEL_FORMAT_COUNT; i++) {
+    led_pixel_format_t expected = (led_pixel_format_t)i;
+    led_pixel_format_t format;
+    const char *name = led_pack_format_name(expected);
+    CHECK(led_pack_format_from_name(name, &format) && format == expected,
+          "%s", name);
+  }
+  led_pixel_format_t format;
+  CHECK(!led_pack_format_from_name("WRGB", &format), "unknown name");
+}
+
+static int spi_bit(const uint8_t *stream, size_t pos) {
+  return (stream[pos / 8] >> (7 - pos % 8)) & 1;
+}
+
+// Reads the SPI stream back as a waveform: every LED bit must be one high
+// pulse and one low pulse within the WS2812B datasheet windows (+-150 ns)
+static void test_spi_encoder_waveform(void) {
+  static const led_spi_bits_t encodings[] = {LED_SPI_BITS_3, LED_SPI_BITS_4};
+  enum { LEN = 48 };
+  uint8_t wire[LEN];
+  uint8_t stream[LEN * 4 + 256];
+
+  for (size_t i = 0; i < LEN; i++) {
+    wire[i] = (uint8_t)render_random();
+  }
+  wire[0] = 0x00;
+  wire[1] = 0xFF;
+
+  for (size_t e = 0; e < sizeof(encodings) / sizeof(encodings[0]); e++) {
+    led_spi_bits_t bits = encodings[e];
+    const uint32_t ns_per_bit = 1000000000u / led_spi_clock_hz(bits);
+    // The WS2812B V5 reset, well over the old 50 us
+    const uint16_t reset_us =
+        led_timing_reset_us(led_timing_get(LED_CHIP_WS2812B), false);
+    size_t size = led_spi_encode(bits, wire, LEN, reset_us, stream);
+    CHECK(size == led_spi_frame_size(bits, LEN, reset_us) &&
+              size <= sizeof(stream),
+          "%d bits: size %zu", bits, size);
+
+    size_t pos = 0;
+    for (size_t i = 0; i < LEN * 8; i++) {
+      int expected = (wire[i / 8] >> (7 - i % 8)) & 1;
+      uint32_t high = 0, low = 0;
+      while (high + low < (uint32_t)bits && spi_bit(stream, pos)) {
+        high++;
+        pos++;
+      }
+      while (high + low < (uint32_t)bits && !spi_bit(stream, pos)) {
+        low++;
+        pos++;
+      }
+      uint32_t high_ns = high * ns_per_bit;
+      uint32_t low_ns = low * ns_per_bit;
+      bool ok = high + low == (uint32_t)bits &&
+                (expected ? high_ns >= 650 && high_ns <= 950 && low_ns >= 300 &&
+                                low_ns <= 600
+                          : high_ns >= 250 && high_ns <= 550 &&
+                                low_ns >= 700 && low_ns <= 1000);
+      CHECK(ok, "%d bits: LED bit %zu is %u ns high, %u ns low", bits, i,
+            high_ns, low_ns);
+      if (!ok) {
+        break;
+      }
+    }
+
+    // The line stays low long enough to latch the frame
+    size_t reset_bits = size * 8 - pos;
+    bool low = true;
+    for (; pos < size * 8; pos++) {
+      low = low && !spi_bit(stream, pos);
+    }
+    uint64_t reset_ns =
+        (uint64_t)reset_bits * 1000000000u / led_spi_clock_hz(bits);
+    CHECK(low && reset_ns >= reset_us * 1000u,
+          "%d bits: reset of %zu bits", bits, reset_bits);
+  }
+}
+
+static void test_timing_ticks(void) {
+  led_timing_ticks_t ticks;
+
+  // 10 MHz RMT clock of the firmware: 0.1 us per tick
+  const led_timing_t *ws2812b = led_timing_get(LED_CHIP_WS2812B);
+  CHECK(led_timing_to_ticks(ws2812b, 10000000, false, &ticks), "WS2812B");
+  CHECK(ticks.t0h == 4 && ticks.t0l == 9 && ticks.t1h == 8 && ticks.t1l == 5,
+        "WS2812B bits %u %u %u %u", ticks.t0h, ticks.t0l, ticks.t1h,
+        ticks.t1l);
+  CHECK(ticks.reset_half == 1500, "WS2812B reset %u", ticks.reset_half);
+  CHECK(led_timing_to_ticks(ws2812b, 10000000, true, &ticks) &&
+            ticks.reset_half == 1400,
+        "WS2812B minimal reset %u", ticks.reset_half);
+
+  // Bits round to the nearest tick, the reset never comes out shorter
+  const led_timing_t *sk6812 = led_timing_get(LED_CHIP_SK6812);
+  CHECK(led_timing_to_ticks(sk6812, 3000000, true, &ticks), "SK6812");
+  CHECK(ticks.t0h == 1 && ticks.t0l == 3 && ticks.t1h == 2 && ticks.t1l == 2,
+        "SK6812 bits %u %u %u %u", ticks.t0h, ticks.t0l, ticks.t1h,
+        ticks.t1l);
+  CHECK(ticks.reset_half == 120, "SK6812 reset %u", ticks.reset_half);
+
+  // Too coarse for a 0.3 us pulse, too fine for a 300 us reset
+  const led_timing_t *ws2815 = led_timing_get(LED_CHIP_WS2815);
+  CHECK(!led_timing_to_ticks(ws2815, 1000000, false, &ticks), "coarse");
+  CHECK(!led_timing_to_ticks(ws2815, 400000000, false, &ticks), "fine");
+
+  // Every chip fits the firmware clock
+  for (int i = 0; i < LED_CHIP_COUNT; i++) {
+    const led_timing_t *timing = led_timing_get((led_chip_t)i);
+    led_chip_t chip;
+    CHECK(led_timing_from_name(timing->name, &chip) && (int)chip == i,
+          "%s name", timing->name);
+    CHECK(led_timing_to_ticks(timing, 10000000, false, &ticks) &&
+              ticks.reset_half * 2 >= timing->reset_us * 10,
+          "%s at 10 MHz", timing->name);
+    CHECK(timing->min_reset_us <= timing->reset_us, "%s reset", timing->name);
+  }
+  // The slow WS2811 mode has a 2.5 us bit
+  led_timing_to_ticks(led_timing_get(LED_CHIP_WS2811), 10000000, false,
+                      &ticks);
+  CHECK(ticks.t0h + ticks.t0l == 25 && ticks.t1h + ticks.t1l == 25,
+        "WS2811 period");
+}
+
+static void test_frame_clock(void) {
+  frame_clock_t clock = {0};
+  frame_clock_start(&clock, 50, 0);
+  CHECK(frame_clock_next(&clock, 1000) == 19000, "wait");
+  // Rendering ran 2.5 periods late: two slots are lost, the grid holds
+  CHECK(frame_clock_next(&clock, 65000) == 15000, "aligned");
+  CHECK(clock.dropped_frames == 2, "dropped %u", clock.dropped_frames);
+
+  // A switch or a resume restarts pacing, the count keeps adding up
+  frame_clock_start(&clock, 20, 100000);
+  CHECK(clock.frames == 0 && clock.dropped_frames == 2, "restart");
+  frame_clock_next(&clock, 180000);
+  CHECK(clock.dropped_frames == 3, "dropped %u", clock.dropped_frames);
+}
+
+// Only values between two output levels keep a static frame moving
+static void test_output_dithers(void) {
+  uint8_t residual[4];
+  led_output_t output;
+  led_output_init(&output, residual, sizeof(residual));
+  led_output_set_brightness(&output, 255);
+
+  // Black, full scale and bright channels never need dithering
+  const uint8_t settled[] = {0, 255, 100, 255};
+  CHECK(!led_output_dithers(&output, true, settled, sizeof(settled)),
+        "settled");
+
+  // A dim value steps between two levels, the output changes over frames
+  led_output_set_brightness(&output, 8);
+  const uint8_t dim[] = {0, 255, 100, 0};
+  CHECK(led_output_dithers(&output, true, dim, sizeof(dim)), "dim");
+  uint8_t first[4];
+  uint8_t pixels[4];
+  memcpy(first, dim, sizeof(first));
+  led_output_apply(&output, first, sizeof(first));
+  bool moved = false;
+  for (int frame = 0; frame < 256 && !moved; frame++) {
+    memcpy(pixels, dim, sizeof(pixels));
+    led_output_apply(&output, pixels, sizeof(pixels));
+    moved = memcmp(pixels, first, sizeof(pixels)) != 0;
+  }
+  CHECK(moved, "dim frame never changes");
+
+  // An unchanged dim frame is dithered for a limited time only
+  int frames = 0;
+  while (led_output_dithers(&output, false, dim, sizeof(dim)) &&
+         frames <= LED_OUTPUT_DITHER_FRAMES) {
+    frames++;
+  }
+  CHECK(frames < LED_OUTPUT_DITHER_FRAMES, "dithered %d frames", frames);
+  CHECK(led_output_dithers(&output, true, dim, sizeof(dim)), "change");
+}
+
+static void test_output_static_scene_idles(void) {
+  // soft_light at the default brightness must stop sending frames, as the
+  // render task does: changed frames restart dithering, unchanged ones
+  // are applied only while led_output_dithers() asks for it
+  render_geometry_t geometry = {.width = 16, .height = 16};
+  uint8_t *tables = malloc(render_tables_size(&geometry) + 1);
+  render_init(&geometry, tables);
+  uint8_t pixels[16 * 16 * 3];
+  uint8_t residual[16 * 16 * 3];
+  led_output_t output;
+  led_output_init(&output, residual, sizeof(residual));
+  led_output_set_brightness(&output, 64);
+
+  const led_effect_info_t *effect =
+      &effect_registry[effect_registry_find("soft_light")];
+  render_frame_t frame = {.pixels = pixels, .geometry = &geometry};
+  bool dithering = false;
+  uint32_t applied = 0;
+  uint32_t t = 0;
+  for (; t < 2000; t++) {
+    frame.changed = false;
+    effect->render(NULL, t, &frame);
+    if (frame.changed || dithering) {
+      dithering =
+          led_output_dithers(&output, frame.changed, pixels, sizeof(pixels));
+      led_output_apply(&output, pixels, sizeof(pixels));
+      applied++;
+    } else if (t > 1000) {
+      break;
+    }
+  }
+  CHECK(t < 2000, "soft_light keeps dithering, %u frames applied",
+        (unsigned)applied);
+  free(tables);
+}
+
+static void test_output_blend(void) {
+  const uint8_t from[] = {0, 255, 100, 7};
+  const uint8_t to[] = {255, 0, 100, 9};
+  uint8_t pixels[4];
+
+  // The ends of a fade are exact, so nothing jumps when it starts or stops
+  memcpy(pixels, to, sizeof(pixels));
+  led_output_blend(pixels, from, sizeof(pixels), 0);
+  CHECK(memcmp(pixels, from, sizeof(pixels)) == 0, "alpha 0");
+  memcpy(pixels, to, sizeof(pixels));
+  led_output_blend(pixels, from, sizeof(pixels), 256);
+  CHECK(memcmp(pixels, to, sizeof(pixels)) == 0, "alpha 256");
+
+  memcpy(pixels, to, sizeof(pixels));
+  led_output_blend(pixels, from, sizeof(pixels), 128);
+  CHECK(pixels[0] == 127 && pixels[1] == 127 && pixels[2] == 100 &&
+            pixels[3] == 8,
+        "half %u %u %u %u", pixels[0], pixels[1], pixels[2], pixels[3]);
+
+  // Rising alpha never moves a channel away from the new frame
+  uint8_t last = 0;
+  for (uint16_t alpha = 0; alpha <= 256; alpha++) {
+    pixels[0] = 255;
+    led_output_blend(pixels, from, 1, alpha);
+    CHECK(pixels[0] >= last, "monotonic at %u", alpha);
+    last = pixels[0];
+  }
+}
+
+static void test_control_store(void) {
+  control_state_t state = {.effect_index = 3,
+                           .brightness = 200,
+                           .running = false,
+                           .transition_ms = 5000};
+  control_state_t unpacked;
+  CHECK(control_state_unpack(control_state_pack(&state), &unpacked) &&
+            unpacked.effect_index == 3 && unpacked.brightness == 200 &&
+            !unpacked.running && unpacked.transition_ms == 5000,
+        "round trip");
+  state.effect_index = -1;
+  state.running = true;
+  CHECK(control_state_unpack(control_state_pack(&state), &unpacked) &&
+            unpacked.effect_index == -1 && unpacked.running,
+        "no effect");
+  CHECK(!control_state_unpack(0, &unpacked), "nothing stored");
+
+  // An encoder spun for 10 s: one write once it has settled
+  control_store_t store;
+  control_state_t current = {.effect_index = 0, .brightness = 64};
+  control_store_init(&store, &current);
+  int writes = 0;
+  uint32_t written_at = 0;
+  for (uint32_t ms = 1000; ms <= 60000; ms += 1000) {
+    if (ms <= 10000) {
+      current.brightness += 10;
+    }
+    if (control_store_poll(&store, &current, 1000)) {
+      control_store_written(&store, true);
+      writes++;
+      written_at = ms;
+    }
+  }
+  CHECK(writes == 1 && written_at == 10000 + CONTROL_STORE_QUIET_MS,
+        "spin: %d writes, last at %u", writes, written_at);
+  CHECK(store.saved.brightness == current.brightness, "saved value");
+
+  // A failed write is retried after the minimum interval
+  current.running = true;
+  int attempts = 0;
+  written_at = 0;
+  for (uint32_t ms = 1000; ms <= 100000 && !written_at; ms += 1000) {
+    if (control_store_poll(&store, &current, 1000)) {
+      attempts++;
+      control_store_written(&store, attempts > 1);
+      written_at = attempts > 1 ? ms : 0;
+    }
+  }
+  CHECK(attempts == 2 && store.saved.running, "retry: %d attempts",
+        attempts);
+  CHECK(written_at ==
+            1000 + CONTROL_STORE_QUIET_MS + CONTROL_STORE_MIN_INTERVAL_MS,
+        "retry at %u", written_at);
+
+  // Changed and changed back: nothing to write
+  control_store_init(&store, &current);
+  current.effect_index = 2;
+  control_store_poll(&store, &current, 1000);
+  current.effect_index = 0;
+  bool wrote = false;
+  for (int i = 0; i < 100; i++) {
+    wrote |= control_store_poll(&store, &current, 1000);
+  }
+  CHECK(!wrote, "reverted change written");
+
+  // A tuned effect parameter is a change like any other
+  int32_t values[] = {8, 6, 0x00FF8000, 15};
+  current.params_checksum = control_params_checksum(values, 4);
+  control_store_init(&store, &current);
+  values[2] = 0x00FF8001;
+  current.params_checksum = control_params_checksum(values, 4);
+  CHECK(current.params_checksum != store.saved.params_checksum,
+        "checksum misses a changed value");
+  wrote = false;
+  for (int i = 0; i < 100 && !wrote; i++) {
+    wrote = control_store_poll(&store, &current, 1000);
+  }
+  CHECK(wrote, "parameter change not written");
+}
+
+static void test_frame_metrics(void) {
+  frame_metrics_t metrics;
+  frame_metrics_reset(&metrics, 5000000);
+  frame_histogram_t *h = &metrics.render;
+  CHECK(frame_histogram_percentile(h, 990) == 0 &&
+            frame_histogram_average(h) == 0,
+        "empty");
+
+  // 1..1000 us, the exact percentiles are 500 and 990
+  for (uint32_t us = 1000; us >= 1; us--) {
+    frame_histogram_add(h, us);
+  }
+  CHECK(h->count == 1000 && h->min_us == 1 && h->max_us == 1000, "range");
+  CHECK(frame_histogram_average(h) == 500, "avg %u",
+        frame_histogram_average(h));
+  uint32_t p50 = frame_histogram_percentile(h, 500);
+  uint32_t p99 = frame_histogram_percentile(h, 990);
+  CHECK(p50 >= 500 && p50 <= 500 * 5 / 4, "p50 %u", p50);
+  CHECK(p99 >= 990 && p99 <= 1000, "p99 %u", p99);
+  CHECK(frame_histogram_percentile(h, 1000) == 1000, "p100");
+
+  // Small values are exact, huge ones land in the last bucket
+  frame_metrics_reset(&metrics, 0);
+  frame_histogram_add(h, 3);
+  frame_histogram_add(h, 7);
+  CHECK(frame_histogram_percentile(h, 500) == 3, "exact small");
+  frame_histogram_add(h, UINT32_MAX);
+  CHECK(frame_histogram_percentile(h, 1000) == UINT32_MAX &&
+            h->buckets[FRAME_METRICS_BUCKETS - 1] == 1,
+        "overflow bucket");
+
+  // 150 frames in 2.5 s
+  frame_metrics_reset(&metrics, 1000000);
+  metrics.frames = 150;
+  CHECK(frame_metrics_fps_x100(&metrics, 3500000) == 6000, "fps %u",
+        frame_metrics_fps_x100(&metrics, 3500000));
+  CHECK(frame_metrics_fps_x100(&metrics, 1000000) == 0, "fps at start");
+}
+
+#define CANARY_SIZE 64
+#define CANARY 0xA5
+
+static bool canary_intact(const uint8_t *p) {
+  for (int i = 0; i < CANARY_SIZE; i++) {
+    if (p[i] != CANARY) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Every effect must stay inside the buffers sized for the geometry
+static void test_effects_fit_geometry(void) {
+  static const uint16_t sizes[][2] = {{1, 1}, {8, 8}, {16, 16}, {32, 8},
+                                      {3, 40}, {1024, 1}};
+
+  for (size_t g = 0; g < sizeof(sizes) / sizeof(sizes[0]); g++) {
+    render_geometry_t geometry = {.width = sizes[g][0],
+                                  .height = sizes[g][1]};
+    uint8_t *tables = malloc(render_tables_size(&geometry) + 1);
+    render_init(&geometry, tables);
+    CHECK(geometry.count == sizes[g][0] * sizes[g][1], "count");
+
+    for (int e = 0; e < effect_registry_count; e++) {
+      const led_effect_info_t *effect = &effect_registry[e];
+      size_t state_size =
+          effect->state_size ? effect->state_size(&geometry) : 0;
+      size_t pixels_size = geometry.count * 3;
+      uint8_t *state = malloc(state_size + CANARY_SIZE);
+      uint8_t *pixels = malloc(pixels_size + CANARY_SIZE);
+      memset(state + state_size, CANARY, CANARY_SIZE);
+      memset(pixels + pixels_size, CANARY, CANARY_SIZE);
+
+      render_frame_t frame = {.pixels = pixels, .geometry = &geometry};
+      if (effect->init) {
+        effect->init(state, &geometry);
+      }
+      for (uint32_t t = 0; t < 500; t++) {
+        effect->render(state, t, &frame);
+      }
+      CHECK(canary_intact(state + state_size), "%s %ux%u: state overrun",
+            effect->id, geometry.width, geometry.height);
+      CHECK(canary_intact(pixels + pixels_size), "%s %ux%u: frame overrun",
+            effect->id, geometry.width, geometry.height);
+      free(state);
+      free(pixels);
+    }
+    free(tables);
+  }
+}
+
+// A frame reported as unchanged must equal the previous one, otherwise the
+// strip would keep showing a stale frame
+static void test_effects_report_changes(void) {
+  // Few stars on the small matrix, so all of them are quiet at times
+  static const uint16_t sizes[][2] = {{16, 16}, {4, 4}};
+  uint8_t previous[16 * 16 * 3];
+  uint8_t pixels[16 * 16 * 3];
+
+  for (int e = 0; e < effect_registry_count; e++) {
+    const led_effect_info_t *effect = &effect_registry[e];
+    uint32_t unchanged = 0;
+
+    for (size_t g = 0; g < sizeof(sizes) / sizeof(sizes[0]); g++) {
+      render_geometry_t geometry = {.width = sizes[g][0],
+                                    .height = sizes[g][1]};
+      uint8_t *tables = malloc(render_tables_size(&geometry) + 1);
+      render_init(&geometry, tables);
+      size_t pixels_size = geometry.count * 3;
+      size_t state_size =
+          effect->state_size ? effect->state_size(&geometry) : 0;
+      uint8_t *state = malloc(state_size + 1);
+      if (effect->init) {
+        effect->init(state, &geometry);
+      }
+
+      render_frame_t frame = {.pixels = pixels, .geometry = &geometry};
+      for (uint32_t t = 0; t < 2000; t++) {
+        memcpy(previous, pixels, pixels_size);
+        frame.changed = false;
+        effect->render(state, t, &frame);
+        if (t == 0) {
+          CHECK(frame.changed, "%s: first frame", effect->id);
+        } else if (!frame.changed) {
+          CHECK(memcmp(previous, pixels, pixels_size) == 0,
+                "%s %ux%u: frame %u differs but is reported unchanged",
+                effect->id, geometry.width, geometry.height, t);
+          unchanged++;
+        }
+      }
+      free(state);
+      free(tables);
+    }
+
+    // Static scenes must be recognized
+    if (strcmp(effect->id, "soft_light") == 0 ||
+        strcmp(effect->id, "stars") == 0) {
+      CHECK(unchanged > 0, "%s: never idle", effect->id);
+    }
+  }
+}
+
+// Renders frames 0..frames-1 from the default seed, returns the last one
+static void render_with_params(const led_effect_info_t *effect,
+                               render_geometry_t *geometry,
+                               const int32_t *params, uint32_t frames,
+                               uint8_t *pixels) {
+  size_t state_size = effect->state_size ? effect->state_size(geometry) : 0;
+  uint8_t *state = malloc(state_size + 1);
+  render_frame_t frame = {
+      .pixels = pixels, .geometry = geometry, .params = params};
+  render_random_seed(0);
+  if (effect->init) {
+    effect->init(state, geometry);
+  }
+  for (uint32_t t = 0; t < frames; t++) {
+    effect->render(state, t, &frame);
+  }
+  free(state);
+}
+
+static void test_effect_params(void) {
+  render_geometry_t geometry = {.width = 8, .height = 8};
+  uint16_t tables[8 * 8];
+  render_init(&geometry, tables);
+  uint8_t expected[8 * 8 * 3];
+  uint8_t pixels[8 * 8 * 3];
+
+  for (int e = 0; e < effect_registry_count; e++) {
+    const led_effect_info_t *effect = &effect_registry[e];
+    CHECK(effect->param_count <= EFFECT_MAX_PARAMS, "%s: too many",
+          effect->id);
+
+    int32_t values[EFFECT_MAX_PARAMS];
+    effect_params_reset(effect, values);
+    for (int i = 0; i < effect->param_count; i++) {
+      const effect_param_info_t *param = &effect->params[i];
+      CHECK(param->min <= param->def && param->def <= param->max &&
+                values[i] == param->def,
+            "%s.%s: default", effect->id, param->name);
+    }
+
+    // The stored defaults render exactly what no values at all render
+    render_with_params(effect, &geometry, NULL, 100, expected);
+    render_with_params(effect, &geometry, values, 100, pixels);
+    CHECK(memcmp(expected, pixels, sizeof(pixels)) == 0,
+          "%s: defaults differ", effect->id);
+
+    // Every end of every range renders
+    for (int i = 0; i < effect->param_count; i++) {
+      const effect_param_info_t *param = &effect->params[i];
+      effect_params_reset(effect, values);
+      values[i] = param->min;
+      render_with_params(effect, &geometry, values, 100, pixels);
+      values[i] = param->max;
+      render_with_params(effect, &geometry, values, 100, pixels);
+    }
+  }
+
+  // A parameter reaches the frame
+  const int32_t blue = 0x0000FF;
+  render_frame_t frame = {
+      .pixels = pixels, .geometry = &geometry, .params = &blue};
+  soft_light_render_frame(NULL, 0, &frame);
+  int center = (4 * 8 + 4) * 3;
+  CHECK(pixels[center] == 0 && pixels[center + 1] == 0 &&
+            pixels[center + 2] == 255,
+        "soft light color %u/%u/%u", pixels[center], pixels[center + 1],
+        pixels[center + 2]);
+}
+
+// Ids name golden files and appear in URLs, names are shown to users
+static void test_effect_registry(void) {
+  CHECK(effect_registry_count > 0, "empty registry");
+  render_geometry_t geometry = {.width = 16, .height = 16};
+  uint16_t tables[16 * 16];
+  render_init(&geometry, tables);
+  size_t max_state_size = effect_registry_max_state_size(&geometry);
+
+  for (int e = 0; e < effect_registry_count; e++) {
+    const led_effect_info_t *effect = &effect_registry[e];
+    CHECK(effect->id && effect->name && effect->description &&
+              effect->render && effect->fps > 0,
+          "entry %d incomplete", e);
+    CHECK(strspn(effect->id, "abcdefghijklmnopqrstuvwxyz0123456789_") ==
+              strlen(effect->id),
+          "%s: id", effect->id);
+    CHECK(effect_registry_find(effect->id) == e, "%s: find by id",
+          effect->id);
+    CHECK(effect_registry_find(effect->name) == e, "%s: find by name",
+          effect->id);
+    CHECK(!effect->state_size ||
+              effect->state_size(&geometry) <= max_state_size,
+          "%s: max state size", effect->id);
+    CHECK(!effect->init == !effect->state_size, "%s: init without state",
+          effect->id);
+  }
+  CHECK(effect_registry_find("FIRE") >= 0, "case-insensitive");
+  CHECK(effect_registry_find("no such effect") == -1, "unknown");
+  CHECK(effect_registry_find(NULL) == -1, "NULL");
+}
+
+typedef struct {
+  const char *name;
+  void (*run)(void);
+} test_case_t;
+
+static const test_case_t tests[] = {
+    {"hsv_matches_legacy", test_hsv_matches_legacy},
+    {"hsv_primaries", test_hsv_primaries},
+    {"hsv_row_matches_single", test_hsv_row_matches_single},
+    {"pack_color_orders", test_pack_color_orders},
+    {"pack_format_names", test_pack_format_names},
+    {"pack_map_layouts", test_pack_map_layouts},
+    {"pack_scatters_by_map", test_pack_scatters_by_map},
+    {"pack_split", test_pack_split},
+    {"spi_encoder_waveform", test_spi_encoder_waveform},
+    {"timing_ticks", test_timing_ticks},
+    {"frame_clock", test_frame_clock},
+    {"output_dithers", test_output_dithers},
+    {"output_static_scene_idles", test_output_static_scene_idles},
+    {"output_blend", test_output_blend},
+    {"control_store", test_control_store},
+    {"frame_metrics", test_frame_metrics},
+    {"effects_fit_geometry", test_effects_fit_geometry},
+    {"effects_report_changes", test_effects_report_changes},
+    {"effect_params", test_effect_params},
+    {"effect_registry", test_effect_registry},
+};
+
+int main(void) {
+  int failed_tests = 0;
+
+  for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+    printf("%s\n", tests[i].name);
+    int before = failed_checks;
+    tests[i].run();
+    if (failed_checks != before) {
+      printf("  FAILED\n");
+      failed_tests++;
+    }
+  }
+  return failed_tests;
+}
@@ -0,0 +1,182 @@
+/*
+ * Golden Frame Test for the Effect Renderers
+ *
+ * Renders every effect from a fixed random seed and compares frames at a
+ * few checkpoints with the ones stored in host/golden. A rewrite of a
+ * renderer (fixed point, lookup tables) passes when its frames are
+ * bit-exact, or within --tolerance levels per channel when a small
+ * rounding change is intended.
+ *
+ * Usage: test_golden <golden dir> [--tolerance N] [--update]
+ *
+ * --update rewrites the golden files from the current renderers; review
+ * the diff before committing them. Files are text, one line of hex RGB
+ * per matrix row, so diffs show which LEDs moved.
+ */
+
+#include "effect_registry.h"
+#include "effect_render.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Not square, so swapped width and height show up
+#define GOLDEN_WIDTH 12
+#define GOLDEN_HEIGHT 8
+#define GOLDEN_COUNT (GOLDEN_WIDTH * GOLDEN_HEIGHT)
+
+// Frame numbers that are stored, the last ones reach slow fades of stars
+static const uint32_t checkpoints[] = {0, 1, 2, 3, 10, 30, 100, 300, 1000};
+#define CHECKPOINT_COUNT (sizeof(checkpoints) / sizeof(checkpoints[0]))
+
+static void write_frame(FILE *file, uint32_t t, const uint8_t *pixels) {
+  fprintf(file, "frame %u\n", t);
+  for (int y = 0; y < GOLDEN_HEIGHT; y++) {
+    for (int x = 0; x < GOLDEN_WIDTH * 3; x++) {
+      fprintf(file, "%02x", pixels[y * GOLDEN_WIDTH * 3 + x]);
+    }
+    fprintf(file, "\n");
+  }
+}
+
+// Reads the next frame, comment lines starting with # are skipped
+static bool read_frame(FILE *file, uint32_t *t, uint8_t *pixels) {
+  char line[GOLDEN_WIDTH * 6 + 16];
+  do {
+    if (!fgets(line, sizeof(line), file)) {
+      return false;
+    }
+  } while (line[0] == '#');
+  if (sscanf(line, "frame %u", t) != 1) {
+    return false;
+  }
+
+  for (int y = 0; y < GOLDEN_HEIGHT; y++) {
+    if (!fgets(line, sizeof(line), file)) {
+      return false;
+    }
+    for (int x = 0; x < GOLDEN_WIDTH * 3; x++) {
+      unsigned int value;
+      if (sscanf(&line[x * 2], "%2x", &value) != 1) {
+        return false;
+      }
+      pixels[y * GOLDEN_WIDTH * 3 + x] = (uint8_t)value;
+    }
+  }
+  return true;
+}
+
+// Largest channel difference, *first is the first channel over tolerance
+static int compare_frames(const uint8_t *expected, const uint8_t *actual,
+                          int tolerance, int *first) {
+  int max_diff = 0;
+  *first = -1;
+  for (int i = 0; i < GOLDEN_COUNT * 3; i++) {
+    int diff = abs((int)expected[i] - (int)actual[i]);
+    if (diff > tolerance && *first < 0) {
+      *first = i;
+    }
+    if (diff > max_diff) {
+      max_diff = diff;
+    }
+  }
+  return max_diff;
+}
+
+// Every registered effect has a file named after its id
+static bool run_effect(const led_effect_info_t *effect, const char *dir,
+                       int tolerance, bool update) {
+  char path[512];
+  snprintf(path, sizeof(path), "%s/%s.txt", dir, effect->id);
+  FILE *file = fopen(path, update ? "w" : "r");
+  if (!file) {
+    printf("  %s: cannot open, run with --update to create it\n", path);
+    return false;
+  }
+
+  static uint16_t tables[GOLDEN_COUNT];
+  render_geometry_t geometry = {.width = GOLDEN_WIDTH,
+                                .height = GOLDEN_HEIGHT};
+  render_init(&geometry, tables);
+  size_t state_size = effect->state_size ? effect->state_size(&geometry) : 0;
+  void *state = malloc(state_size ? state_size : 1);
+  uint8_t pixels[GOLDEN_COUNT * 3];
+  uint8_t expected[GOLDEN_COUNT * 3];
+  render_frame_t frame = {.pixels = pixels, .geometry = &geometry};
+  bool ok = true;
+
+  if (update) {
+    fprintf(file, "# %s %ux%u, default seed, RGB hex per row\n",
+            effect->id, GOLDEN_WIDTH, GOLDEN_HEIGHT);
+  }
+
+  render_random_seed(0);
+  if (effect->init) {
+    effect->init(state, &geometry);
+  }
+  size_t next = 0;
+  for (uint32_t t = 0; next < CHECKPOINT_COUNT; t++) {
+    memset(pixels, 0, sizeof(pixels));
+    effect->render(state, t, &frame);
+    if (t != checkpoints[next]) {
+      continue;
+    }
+    next++;
+
+    if (update) {
+      write_frame(file, t, pixels);
+      continue;
+    }
+    uint32_t golden_t;
+    if (!read_frame(file, &golden_t, expected) || golden_t != t) {
+      printf("  %s: frame %u missing or malformed\n", path, t);
+      ok = false;
+      break;
+    }
+    int first;
+    int max_diff = compare_frames(expected, pixels, tolerance, &first);
+    if (first >= 0) {
+      int led = first / 3;
+      printf("  %s frame %u: LED %d,%d channel %d is %u, expected %u "
+             "(max difference %d)\n",
+             effect->id, t, led % GOLDEN_WIDTH, led / GOLDEN_WIDTH,
+             first % 3, pixels[first], expected[first], max_diff);
+      ok = false;
+    }
+  }
+
+  free(state);
+  fclose(file);
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  const char *dir = NULL;
+  int tolerance = 0;
+  bool update = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--update") == 0) {
+      update = true;
+    } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+      tolerance = atoi(argv[++i]);
+    } else {
+      dir = argv[i];
+    }
+  }
+  if (!dir) {
+    fprintf(stderr, "usage: %s <golden dir> [--tolerance N] [--update]\n",
+            argv[0]);
+    return 2;
+  }
+
+  int failed = 0;
+  for (int e = 0; e < effect_registry_count; e++) {
+    printf("%s\n", effect_registry[e].id);
+    if (!run_effect(&effect_registry[e], dir, tolerance, update)) {
+      printf("  FAILED\n");
+      failed++;
+    }
+  }
+  return failed;
+}
@@ -0,0 +1,50 @@
+/*
+ * 8-bit HSV Colors Implementation
+ */
+
+#include "color_hsv.h"
+#include "fixed_math.h"
+
+// The three channels take one of four levels in every 60 degree sector.
+// The levels are packed into one word, a level is selected by its shift.
+enum { LEVEL_MAX = 0, LEVEL_MIN = 8, LEVEL_RISE = 16, LEVEL_FALL = 24 };
+
+// Level of red, green and blue for each sector
+static const uint8_t sector_levels[6][3] = {
+    {LEVEL_MAX, LEVEL_RISE, LEVEL_MIN},  // red -> yellow
+    {LEVEL_FALL, LEVEL_MAX, LEVEL_MIN},  // yellow -> green
+    {LEVEL_MIN, LEVEL_MAX, LEVEL_RISE},  // green -> cyan
+    {LEVEL_MIN, LEVEL_FALL, LEVEL_MAX},  // cyan -> blue
+    {LEVEL_RISE, LEVEL_MIN, LEVEL_MAX},  // blue -> magenta
+    {LEVEL_MAX, LEVEL_MIN, LEVEL_FALL},  // magenta -> red
+};
+
+static inline void hsv8_convert(hsv8_t hsv, uint8_t rgb[3]) {
+  // hue * 6: the high byte is the sector, the low byte the position in it
+  uint16_t hue6 = (uint16_t)hsv.h * 6;
+  const uint8_t *levels = sector_levels[hue6 >> 8];
+
+  uint8_t min = scale8(hsv.v, 255 - hsv.s);
+  uint8_t adj = scale8(hsv.v - min, hue6 & 0xFF);
+  uint32_t values = (uint32_t)hsv.v << LEVEL_MAX | (uint32_t)min << LEVEL_MIN |
+                    (uint32_t)(uint8_t)(min + adj) << LEVEL_RISE |
+                    (uint32_t)(uint8_t)(hsv.v - adj) << LEVEL_FALL;
+
+  rgb[0] = (uint8_t)(values >> levels[0]);
+  rgb[1] = (uint8_t)(values >> levels[1]);
+  rgb[2] = (uint8_t)(values >> levels[2]);
+}
+
+void hsv8_to_rgb(hsv8_t hsv, uint8_t *r, uint8_t *g, uint8_t *b) {
+  uint8_t rgb[3];
+  hsv8_convert(hsv, rgb);
+  *r = rgb[0];
+  *g = rgb[1];
+  *b = rgb[2];
+}
+
+void hsv8_row_to_pixels(const hsv8_t *hsv, uint8_t *pixels, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    hsv8_convert(hsv[i], &pixels[i * 3]);
+  }
+}
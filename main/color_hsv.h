@@ -0,0 +1,50 @@
+/*
+ * 8-bit HSV Colors
+ *
+ * Integer HSV to RGB conversion without divisions or per-pixel branches.
+ * Hue is a full turn in 256 steps, so hue shifts wrap around for free.
+ * Pure logic, builds on a host.
+ */
+
+#ifndef COLOR_HSV_H
+#define COLOR_HSV_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Converts degrees and 0-100 percents of the old API to the 8-bit scale
+#define HSV8_HUE_DEG(deg) ((uint8_t)(((deg) % 360) * 256 / 360))
+#define HSV8_PERCENT(pct) ((uint8_t)(((pct) * 255 + 50) / 100))
+
+typedef struct {
+  uint8_t h; // Hue, 256 is a full turn (0 = red, 85 = green, 171 = blue)
+  uint8_t s; // Saturation, 0-255
+  uint8_t v; // Value, 0-255
+} hsv8_t;
+
+/**
+ * @brief Convert one HSV color to RGB
+ * @param hsv Color
+ * @param r Red channel
+ * @param g Green channel
+ * @param b Blue channel
+ */
+void hsv8_to_rgb(hsv8_t hsv, uint8_t *r, uint8_t *g, uint8_t *b);
+
+/**
+ * @brief Convert a run of HSV colors into RGB frame pixels
+ * @param hsv Colors
+ * @param pixels Destination, count * 3 bytes
+ * @param count Number of colors
+ */
+void hsv8_row_to_pixels(const hsv8_t *hsv, uint8_t *pixels, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COLOR_HSV_H
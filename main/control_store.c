@@ -0,0 +1,81 @@
+/*
+ * Control State Store Implementation
+ */
+
+#include "control_store.h"
+
+// Bits 0-7 hold the version, a new layout must bump it
+#define CONTROL_STATE_VERSION 1
+
+uint64_t control_state_pack(const control_state_t *state) {
+  return (uint64_t)CONTROL_STATE_VERSION |
+         (uint64_t)(uint8_t)state->effect_index << 8 |
+         (uint64_t)state->brightness << 16 |
+         (uint64_t)(state->running ? 1 : 0) << 24 |
+         (uint64_t)state->transition_ms << 32;
+}
+
+uint32_t control_params_checksum(const int32_t *values, size_t count) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < count; i++) {
+    uint32_t value = (uint32_t)values[i];
+    for (int byte = 0; byte < 4; byte++) {
+      hash = (hash ^ ((value >> (byte * 8)) & 0xFF)) * 16777619u;
+    }
+  }
+  return hash;
+}
+
+bool control_state_unpack(uint64_t packed, control_state_t *state) {
+  if ((packed & 0xFF) != CONTROL_STATE_VERSION) {
+    return false;
+  }
+  uint8_t effect_index = (packed >> 8) & 0xFF;
+  state->effect_index = effect_index == 0xFF ? -1 : effect_index;
+  state->brightness = (packed >> 16) & 0xFF;
+  state->running = (packed >> 24) & 1;
+  state->transition_ms = (packed >> 32) & 0xFFFF;
+  state->params_checksum = 0;
+  return true;
+}
+
+static bool state_equal(const control_state_t *a, const control_state_t *b) {
+  return a->effect_index == b->effect_index &&
+         a->brightness == b->brightness && a->running == b->running &&
+         a->transition_ms == b->transition_ms &&
+         a->params_checksum == b->params_checksum;
+}
+
+// Adds without wrapping, the counters only need to reach the thresholds
+static uint32_t add_saturated(uint32_t a, uint32_t b) {
+  return a + b < a ? UINT32_MAX : a + b;
+}
+
+void control_store_init(control_store_t *store, const control_state_t *saved) {
+  store->saved = *saved;
+  store->pending = *saved;
+  store->quiet_ms = 0;
+  // Nothing was written this boot, the first change only waits to settle
+  store->since_save_ms = CONTROL_STORE_MIN_INTERVAL_MS;
+}
+
+bool control_store_poll(control_store_t *store, const control_state_t *current,
+                        uint32_t elapsed_ms) {
+  store->since_save_ms = add_saturated(store->since_save_ms, elapsed_ms);
+  if (!state_equal(current, &store->pending)) {
+    store->pending = *current;
+    store->quiet_ms = 0;
+    return false;
+  }
+  store->quiet_ms = add_saturated(store->quiet_ms, elapsed_ms);
+  return !state_equal(&store->pending, &store->saved) &&
+         store->quiet_ms >= CONTROL_STORE_QUIET_MS &&
+         store->since_save_ms >= CONTROL_STORE_MIN_INTERVAL_MS;
+}
+
+void control_store_written(control_store_t *store, bool ok) {
+  if (ok) {
+    store->saved = store->pending;
+  }
+  store->since_save_ms = 0;
+}
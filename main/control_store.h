@@ -0,0 +1,96 @@
+/*
+ * Control State Store
+ *
+ * Decides when the control state (effect, brightness, power, transition
+ * and effect parameters) is written to flash. A change is saved once it has
+ * been left alone for a while and not sooner than a minimum interval after
+ * the last write, so a spun encoder or a toggling button costs one write
+ * instead of one per step. The state is packed into a single 64-bit value;
+ * parameters are tracked by a checksum and stored by the caller, one NVS
+ * blob per changed effect. Pure logic, time is passed in by the caller.
+ */
+
+#ifndef CONTROL_STORE_H
+#define CONTROL_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CONTROL_STORE_QUIET_MS 5000         // Unchanged this long before a save
+#define CONTROL_STORE_MIN_INTERVAL_MS 30000 // Between two saves
+
+typedef struct {
+  int16_t effect_index; // -1 for none
+  uint8_t brightness;
+  bool running;
+  uint16_t transition_ms;
+  uint32_t params_checksum; // Of all parameter values, not packed
+} control_state_t;
+
+typedef struct {
+  control_state_t saved;   // State the flash holds
+  control_state_t pending; // Last state seen by control_store_poll()
+  uint32_t quiet_ms;       // Time pending has not changed
+  uint32_t since_save_ms;  // Time since the last write attempt
+} control_store_t;
+
+/**
+ * @brief Pack a state into the value stored in NVS
+ * @param state State
+ * @return Packed state with a format version
+ */
+uint64_t control_state_pack(const control_state_t *state);
+
+/**
+ * @brief Checksum of effect parameter values, tells a change apart
+ * @param values Parameter values
+ * @param count Number of values
+ * @return FNV-1a hash of the values
+ */
+uint32_t control_params_checksum(const int32_t *values, size_t count);
+
+/**
+ * @brief Unpack a stored value, ranges are left to the caller to check
+ * @param packed Value from NVS
+ * @param state Destination, params_checksum is set to 0
+ * @return false if the value was written by an unknown format version
+ */
+bool control_state_unpack(uint64_t packed, control_state_t *state);
+
+/**
+ * @brief Start tracking from the state the flash holds
+ * @param store Store
+ * @param saved State loaded at boot, or the defaults if none was stored
+ */
+void control_store_init(control_store_t *store, const control_state_t *saved);
+
+/**
+ * @brief Feed the current state, called periodically
+ * @param store Store
+ * @param current Current state
+ * @param elapsed_ms Time since the previous call
+ * @return true if store->pending should be written now
+ */
+bool control_store_poll(control_store_t *store, const control_state_t *current,
+                        uint32_t elapsed_ms);
+
+/**
+ * @brief Report the outcome of a write requested by control_store_poll()
+ *
+ * A failed write is retried after the minimum interval.
+ *
+ * @param store Store
+ * @param ok true if store->pending reached the flash
+ */
+void control_store_written(control_store_t *store, bool ok);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CONTROL_STORE_H
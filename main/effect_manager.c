@@ -3,9 +3,12 @@
  */
 
 #include "effect_manager.h"
+#include "control_store.h"
+#include "effect_registry.h"
 #include "driver/gpio.h"
 #include "esp_err.h"
 #include "esp_log.h"
+#include "nvs.h"
 #include "freertos/queue.h"
 #include "freertos/task.h"
 #include <stdint.h>
@@ -14,16 +17,161 @@
 #include <string.h>
 
 static const char *TAG = "effect_manager";
-// Определение всех доступных эффектов
-static const led_effect_info_t available_effects[] = {
-    {"Soft Light", led_strip_soft_light_task, "Soft light effect"},
-    {"Fire", led_strip_fire_task, "Fire simulation effect"},
-    {"Firefly mode", led_strip_firefly_task, "Firefly in the dark"},
-    {"Stars", led_strip_stars_task, "Starlight effect"},
-};
 
-static const int EFFECT_COUNT =
-    sizeof(available_effects) / sizeof(available_effects[0]);
+#define CONTROL_SAVE_POLL_MS 1000
+
+// Состояние управления, которое видит задача отрисовки
+static control_state_t control_snapshot(const led_effect_params_t *params) {
+  return (control_state_t){
+      .effect_index = params->effect_index,
+      .brightness = params->brightness,
+      .running = params->running,
+      .transition_ms = params->transition_ms,
+      .params_checksum = control_params_checksum(
+          params->param_values,
+          (size_t)params->effect_count * EFFECT_MAX_PARAMS)};
+}
+
+static void params_key(const led_effect_info_t *effect,
+                       char key[NVS_KEY_NAME_MAX_SIZE]) {
+  snprintf(key, NVS_KEY_NAME_MAX_SIZE, LED_CONFIG_NVS_PARAMS_PREFIX "%s",
+           effect->id);
+}
+
+// Значения параметров по умолчанию, поверх них сохраненные. Blob другого
+// размера (схема эффекта изменилась) пропускается, диапазоны проверяет
+// led_render_start. NULL если не хватило памяти
+static int32_t *params_load(const led_effect_info_t *effects,
+                            int effect_count) {
+  int32_t *values = malloc((size_t)effect_count * EFFECT_MAX_PARAMS *
+                           sizeof(int32_t));
+  if (!values) {
+    return NULL;
+  }
+  for (int i = 0; i < effect_count; i++) {
+    effect_params_reset(&effects[i], &values[i * EFFECT_MAX_PARAMS]);
+  }
+
+  nvs_handle_t nvs_handle;
+  if (nvs_open(LED_CONFIG_NVS_NAMESPACE, NVS_READONLY, &nvs_handle) !=
+      ESP_OK) {
+    return values;
+  }
+  for (int i = 0; i < effect_count; i++) {
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    int32_t stored[EFFECT_MAX_PARAMS];
+    size_t size = sizeof(stored);
+    params_key(&effects[i], key);
+    if (nvs_get_blob(nvs_handle, key, stored, &size) == ESP_OK &&
+        size == effects[i].param_count * sizeof(int32_t)) {
+      memcpy(&values[i * EFFECT_MAX_PARAMS], stored, size);
+    }
+  }
+  nvs_close(nvs_handle);
+  return values;
+}
+
+// Записывает параметры эффектов, отличающиеся от saved, и обновляет saved
+static esp_err_t params_save(nvs_handle_t nvs_handle,
+                             const led_effect_params_t *params,
+                             int32_t *saved) {
+  for (int i = 0; i < params->effect_count; i++) {
+    const led_effect_info_t *effect = &params->effects[i];
+    size_t size = effect->param_count * sizeof(int32_t);
+    int32_t values[EFFECT_MAX_PARAMS];
+    memcpy(values, &params->param_values[i * EFFECT_MAX_PARAMS], size);
+    if (size == 0 ||
+        memcmp(values, &saved[i * EFFECT_MAX_PARAMS], size) == 0) {
+      continue;
+    }
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    params_key(effect, key);
+    esp_err_t err = nvs_set_blob(nvs_handle, key, values, size);
+    if (err != ESP_OK) {
+      return err;
+    }
+    memcpy(&saved[i * EFFECT_MAX_PARAMS], values, size);
+  }
+  return ESP_OK;
+}
+
+// Последнее сохраненное состояние, false если его нет или оно не подходит
+static bool control_load(control_state_t *state, int effect_count) {
+  nvs_handle_t nvs_handle;
+  uint64_t packed = 0;
+  if (nvs_open(LED_CONFIG_NVS_NAMESPACE, NVS_READONLY, &nvs_handle) !=
+      ESP_OK) {
+    return false;
+  }
+  esp_err_t err = nvs_get_u64(nvs_handle, LED_CONFIG_NVS_CONTROL, &packed);
+  nvs_close(nvs_handle);
+  if (err != ESP_OK || !control_state_unpack(packed, state)) {
+    return false;
+  }
+  if (state->effect_index < 0 || state->effect_index >= effect_count ||
+      state->brightness == 0 || state->transition_ms > LED_TRANSITION_MS_MAX) {
+    ESP_LOGW(TAG, "Invalid control state in NVS, using defaults");
+    return false;
+  }
+  return true;
+}
+
+// saved_params holds the parameter values the flash has, NULL to skip them
+static bool control_save(const control_state_t *state,
+                         const led_effect_params_t *params,
+                         int32_t *saved_params) {
+  nvs_handle_t nvs_handle;
+  esp_err_t err = nvs_open(LED_CONFIG_NVS_NAMESPACE, NVS_READWRITE,
+                           &nvs_handle);
+  if (err == ESP_OK) {
+    err = nvs_set_u64(nvs_handle, LED_CONFIG_NVS_CONTROL,
+                      control_state_pack(state));
+    if (err == ESP_OK && saved_params) {
+      err = params_save(nvs_handle, params, saved_params);
+    }
+    if (err == ESP_OK) {
+      err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+  }
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "Failed to save control state: %s", esp_err_to_name(err));
+    return false;
+  }
+  ESP_LOGI(TAG, "Control state saved: effect %d, brightness %u, %s",
+           state->effect_index, state->brightness,
+           state->running ? "on" : "off");
+  return true;
+}
+
+// Сохраняет состояние после того, как оно перестало меняться: вращение
+// энкодера или серия нажатий дают одну запись во flash
+static void control_save_task(void *arg) {
+  effect_manager_t *manager = (effect_manager_t *)arg;
+  led_effect_params_t *params = manager->params;
+  control_store_t store;
+  control_state_t state = control_snapshot(params);
+  control_store_init(&store, &state);
+
+  // Параметры при старте совпадают с сохраненными или по умолчанию
+  size_t params_size =
+      (size_t)params->effect_count * EFFECT_MAX_PARAMS * sizeof(int32_t);
+  int32_t *saved_params = malloc(params_size);
+  if (saved_params) {
+    memcpy(saved_params, params->param_values, params_size);
+  } else {
+    ESP_LOGW(TAG, "Effect parameters will not be saved");
+  }
+
+  while (true) {
+    vTaskDelay(pdMS_TO_TICKS(CONTROL_SAVE_POLL_MS));
+    state = control_snapshot(params);
+    if (control_store_poll(&store, &state, CONTROL_SAVE_POLL_MS)) {
+      control_store_written(&store,
+                            control_save(&store.pending, params, saved_params));
+    }
+  }
+}
 
 // Обработка кнопки с debouncing
 static void button_secondary_task(void *arg) {
@@ -31,7 +179,7 @@ static void button_secondary_task(void *arg) {
   effect_manager_t *manager = params->manager;
   int button_gpio = params->button_secondary_gpio;
 
-  bool last_state = !params->manager->params->running;
+  bool last_state = true; // Pull-up, поэтому HIGH = не нажата
   TickType_t last_change = 0;
   const TickType_t debounce_time = pdMS_TO_TICKS(50);
 
@@ -45,11 +193,7 @@ static void button_secondary_task(void *arg) {
       if ((now - last_change) > debounce_time) {
         if (current_state == false) { // Кнопка нажата (LOW)
           ESP_LOGI(TAG, "Button [secondary] pressed, toggle");
-          if (manager->params->running) {
-            effect_manager_stop_current(manager);
-          } else {
-            effect_manager_start_current(manager);
-          }
+          effect_manager_toggle_running(manager);
         }
         last_change = now;
       }
@@ -99,9 +243,7 @@ static void rotate_encoder_task(void *arg) {
   TickType_t last_change = xTaskGetTickCount();
 
   const TickType_t debounce_time = pdMS_TO_TICKS(50);
-  const uint8_t min_brightness = 0;
-  const uint8_t max_brightness = 255;
-  const uint8_t brightness_step = 10;
+  const int8_t brightness_step = 10;
 
   ESP_LOGI(TAG, "KY040_ENCODER started on GPIO clk: %d dt: %d", clk_gpio,
            dt_gpio);
@@ -114,27 +256,13 @@ static void rotate_encoder_task(void *arg) {
     // Detect falling edge on CLK (common encoder pattern)
     if (last_clk_state == 1 && clk_state == 0) {
       if ((now - last_change) > debounce_time) {
-        uint8_t current_brightness = effect_manager_get_brightness(manager);
-        uint8_t new_brightness = current_brightness;
-
-        // Check DT state at the moment of CLK falling edge
-        if (dt_state == 1) {
-          // Clockwise rotation
-          new_brightness = (new_brightness + brightness_step > max_brightness)
-                               ? max_brightness
-                               : new_brightness + brightness_step;
-        } else {
-          // Counter-clockwise rotation
-          new_brightness = (new_brightness - (brightness_step * 2) <= 0)
-                               ? min_brightness
-                               : new_brightness - (brightness_step * 2);
-        }
-
-        if (current_brightness != new_brightness) {
-          effect_manager_set_brightness(manager, new_brightness);
-          ESP_LOGI(TAG, "Brightness changed: %d -> %d", current_brightness,
-                   new_brightness);
-        }
+        // Check DT state at the moment of CLK falling edge: clockwise
+        // brightens, counter-clockwise dims twice as fast. The step is
+        // relative, so it adds up with other input instead of
+        // overwriting it.
+        int8_t step = dt_state == 1 ? brightness_step : -2 * brightness_step;
+        effect_manager_adjust_brightness(manager, step);
+        ESP_LOGD(TAG, "Brightness step %+d", step);
 
         last_change = now;
       }
@@ -199,83 +327,79 @@ esp_err_t effect_manager_init(effect_manager_t *manager,
   }
 
   manager->params = params;
-  manager->effects = available_effects;
-  manager->effect_count = EFFECT_COUNT;
-  manager->current_effect = 0;
+  manager->effects = effect_registry;
+  manager->effect_count = effect_registry_count;
   manager->button_task_handle = NULL;
   manager->button_params = NULL;
   manager->rotate_encoder_params_t = NULL;
 
-  // Установить яркость по умолчанию, если не задана
-  if (manager->params->brightness == 0) {
-    manager->params->brightness = 64; // 30% яркости по умолчанию
+  // Состояние до старта задачи задается напрямую, потом только командами.
+  // Первый кадр сразу рисует сцену, которая была до перезагрузки.
+  params->effects = effect_registry;
+  params->effect_count = effect_registry_count;
+  control_state_t state;
+  if (control_load(&state, effect_registry_count)) {
+    params->effect_index = state.effect_index;
+    params->brightness = state.brightness;
+    params->running = state.running;
+    params->transition_ms = state.transition_ms;
+  } else {
+    params->effect_index = 0;
+    params->running = true;
+    // Установить яркость по умолчанию, если не задана
+    if (manager->params->brightness == 0) {
+      manager->params->brightness = 64; // 30% яркости по умолчанию
+    }
+  }
+
+  // Один буфер состояния на все эффекты, размер зависит от геометрии.
+  // Сохраненные параметры копируются при запуске
+  int32_t *stored_params = params_load(effect_registry, effect_registry_count);
+  params->stored_params = stored_params;
+  esp_err_t ret = led_render_start(
+      manager->params,
+      effect_registry_max_state_size(&manager->params->geometry));
+  params->stored_params = NULL;
+  free(stored_params);
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to start render task");
+    return ret;
   }
 
-  ESP_LOGI(TAG, "Effect manager initialized with %d effects, brightness: %d",
-           EFFECT_COUNT, manager->params->brightness);
+  if (xTaskCreate(control_save_task, "control_save", 3072, manager, 2,
+                  &manager->control_save_task_handle) != pdPASS) {
+    // Лампа работает и без сохранения, просто не переживет перезагрузку
+    ESP_LOGW(TAG, "Failed to create control save task");
+    manager->control_save_task_handle = NULL;
+  }
 
-  return effect_manager_switch_to(manager, manager->current_effect);
+  ESP_LOGI(TAG, "Effect manager initialized with %d effects, brightness: %d",
+           effect_registry_count, manager->params->brightness);
+  return ESP_OK;
 }
 
 esp_err_t effect_manager_stop_current(effect_manager_t *manager) {
   if (!manager || !manager->params) {
     return ESP_ERR_INVALID_ARG;
   }
-  if (manager->params->task_handle) {
-    ESP_LOGI(TAG, "Stopping current effect: %s",
-             manager->effects[manager->current_effect].name);
-
-    // Сигнализируем о завершении
-    manager->params->running = false;
-
-    // Ждем самостоятельного завершения задачи
-    for (int i = 0; i < 20; i++) { // 200ms максимум
-      if (manager->params->task_handle == NULL) {
-        ESP_LOGI(TAG, "Task finished gracefully");
-        return ESP_OK;
-      }
-      vTaskDelay(pdMS_TO_TICKS(50));
-    }
-
-    // Если задача не завершилась сама, принудительно удаляем
-    ESP_LOGW(TAG, "Force deleting task");
-    vTaskDelete(manager->params->task_handle);
-    manager->params->task_handle = NULL;
-  }
-  return ESP_OK;
+  // Задача отрисовки сама погасит матрицу перед следующим кадром
+  ESP_LOGI(TAG, "Stopping current effect");
+  return led_render_send(manager->params, LED_COMMAND_SET_RUNNING, 0);
 }
 
 esp_err_t effect_manager_start_current(effect_manager_t *manager) {
-  if (!manager || manager->current_effect < 0) {
-    ESP_LOGE(TAG, "Don't have current_effect to switch");
+  if (!manager || !manager->params) {
     return ESP_ERR_INVALID_ARG;
   }
+  ESP_LOGI(TAG, "Starting current effect");
+  return led_render_send(manager->params, LED_COMMAND_SET_RUNNING, 1);
+}
 
-  // Убеждаемся, что текущий эффект остановлен
-  if (manager->params->task_handle != NULL) {
-    ESP_LOGI(TAG, "Stopping current task before starting");
-    effect_manager_stop_current(manager);
-    // Даем время RMT драйверу завершить все операции
-    vTaskDelay(pdMS_TO_TICKS(100));
-  }
-
-  // Устанавливаем флаг запуска
-  manager->params->running = true;
-
-  const led_effect_info_t *effect = &manager->effects[manager->current_effect];
-
-  BaseType_t result =
-      xTaskCreate(effect->func, "led_effect", 4096, manager->params, 5,
-                  &manager->params->task_handle);
-
-  if (result == pdPASS) {
-    ESP_LOGI(TAG, "Started effect [%d]: %s", manager->current_effect,
-             effect->name);
-    return ESP_OK;
-  } else {
-    ESP_LOGE(TAG, "Failed to create task for effect: %s", effect->name);
-    return ESP_FAIL;
+esp_err_t effect_manager_toggle_running(effect_manager_t *manager) {
+  if (!manager || !manager->params) {
+    return ESP_ERR_INVALID_ARG;
   }
+  return led_render_send(manager->params, LED_COMMAND_TOGGLE_RUNNING, 0);
 }
 
 esp_err_t effect_manager_switch_to(effect_manager_t *manager,
@@ -285,30 +409,11 @@ esp_err_t effect_manager_switch_to(effect_manager_t *manager,
     return ESP_ERR_INVALID_ARG;
   }
 
-  // Остановить текущий эффект
-  effect_manager_stop_current(manager);
-
-  // Даем время RMT драйверу завершить все операции
-  vTaskDelay(pdMS_TO_TICKS(100));
-
-  // Сбросить флаг
-  manager->params->running = true;
-
-  // Запустить новый эффект
-  manager->current_effect = effect_index;
-  const led_effect_info_t *effect = &manager->effects[effect_index];
-
-  BaseType_t result =
-      xTaskCreate(effect->func, "led_effect", 4096, manager->params, 5,
-                  &manager->params->task_handle);
-
-  if (result == pdPASS) {
-    ESP_LOGI(TAG, "Switched to effect [%d]: %s", effect_index, effect->name);
-    return ESP_OK;
-  } else {
-    ESP_LOGE(TAG, "Failed to create task for effect: %s", effect->name);
-    return ESP_FAIL;
-  }
+  // Новый эффект подхватывается задачей отрисовки между кадрами
+  ESP_LOGI(TAG, "Switching to effect [%d]: %s", effect_index,
+           manager->effects[effect_index].name);
+  return led_render_send(manager->params, LED_COMMAND_SET_EFFECT,
+                         effect_index);
 }
 
 esp_err_t effect_manager_switch_next(effect_manager_t *manager) {
@@ -316,8 +421,9 @@ esp_err_t effect_manager_switch_next(effect_manager_t *manager) {
     return ESP_ERR_INVALID_ARG;
   }
 
-  int next_effect = (manager->current_effect + 1) % manager->effect_count;
-  return effect_manager_switch_to(manager, next_effect);
+  // The render task picks the next one, so two quick presses from
+  // different sources move two effects on
+  return led_render_send(manager->params, LED_COMMAND_NEXT_EFFECT, 0);
 }
 
 esp_err_t
@@ -435,18 +541,57 @@ esp_err_t effect_manager_start_physical_controls_handler(
 }
 
 const char *effect_manager_get_current_name(effect_manager_t *manager) {
-  if (!manager || manager->current_effect < 0 ||
-      manager->current_effect >= manager->effect_count) {
+  int index = effect_manager_get_current_index(manager);
+  if (index < 0 || index >= manager->effect_count) {
     return "Unknown";
   }
-  return manager->effects[manager->current_effect].name;
+  return manager->effects[index].name;
 }
 
 int effect_manager_get_current_index(effect_manager_t *manager) {
+  if (!manager || !manager->params) {
+    return -1;
+  }
+  return manager->params->effect_index;
+}
+
+int effect_manager_find_effect(effect_manager_t *manager, const char *name) {
   if (!manager) {
     return -1;
   }
-  return manager->current_effect;
+  return effect_registry_find(name);
+}
+
+int effect_manager_find_param(effect_manager_t *manager, int effect_index,
+                              const char *name) {
+  if (!manager || !name || effect_index < 0 ||
+      effect_index >= manager->effect_count) {
+    return -1;
+  }
+  const led_effect_info_t *effect = &manager->effects[effect_index];
+  for (int i = 0; i < effect->param_count; i++) {
+    if (strcasecmp(effect->params[i].name, name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+esp_err_t effect_manager_set_param(effect_manager_t *manager, int effect_index,
+                                   const char *name, int32_t value) {
+  if (!manager || !manager->params) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  int param_index = effect_manager_find_param(manager, effect_index, name);
+  if (param_index < 0) {
+    ESP_LOGE(TAG, "Parameter not found: %s", name ? name : "(null)");
+    return ESP_ERR_NOT_FOUND;
+  }
+  ESP_LOGI(TAG, "%s: %s = %ld", manager->effects[effect_index].name, name,
+           (long)value);
+  return led_render_set_param(manager->params, effect_index, param_index,
+                              value);
 }
 
 esp_err_t effect_manager_get_status(effect_manager_t *manager,
@@ -455,24 +600,11 @@ esp_err_t effect_manager_get_status(effect_manager_t *manager,
     return ESP_ERR_INVALID_ARG;
   }
 
-  status->current_effect = manager->current_effect;
+  status->current_effect = effect_manager_get_current_index(manager);
   status->total_effects = manager->effect_count;
   strncpy(status->current_name, effect_manager_get_current_name(manager),
           sizeof(status->current_name) - 1);
   status->current_name[sizeof(status->current_name) - 1] = '\0';
-
-  // Формируем JSON-like список эффектов
-  char *ptr = status->effects_list;
-  int remaining = sizeof(status->effects_list) - 1;
-  *ptr = '\0'; // Начинаем с пустой строки
-
-  for (int i = 0; i < manager->effect_count && remaining > 0; i++) {
-    int written = snprintf(ptr, remaining, "%s%s", (i > 0) ? "," : "",
-                           manager->effects[i].name);
-    ptr += written;
-    remaining -= written;
-  }
-
   return ESP_OK;
 }
 
@@ -488,9 +620,9 @@ esp_err_t effect_manager_set_brightness(effect_manager_t *manager,
     brightness = 1;
   }
 
-  manager->params->brightness = brightness;
   ESP_LOGI(TAG, "Brightness set to %d", brightness);
-  return ESP_OK;
+  return led_render_send(manager->params, LED_COMMAND_SET_BRIGHTNESS,
+                         brightness);
 }
 
 uint8_t effect_manager_get_brightness(effect_manager_t *manager) {
@@ -506,16 +638,9 @@ esp_err_t effect_manager_adjust_brightness(effect_manager_t *manager,
     return ESP_ERR_INVALID_ARG;
   }
 
-  int new_brightness = (int)manager->params->brightness + delta;
-
-  // Ограничиваем диапазон
-  if (new_brightness < 1) {
-    new_brightness = 1;
-  } else if (new_brightness > 255) {
-    new_brightness = 255;
-  }
-
-  return effect_manager_set_brightness(manager, (uint8_t)new_brightness);
+  // Задача отрисовки сама ограничит диапазон 1-255
+  return led_render_send(manager->params, LED_COMMAND_ADJUST_BRIGHTNESS,
+                         delta);
 }
 esp_err_t effect_manager_set_effect_by_name(effect_manager_t *manager,
                                             const char *name) {
@@ -523,14 +648,12 @@ esp_err_t effect_manager_set_effect_by_name(effect_manager_t *manager,
     return ESP_ERR_INVALID_ARG;
   }
 
-  for (int i = 0; i < manager->effect_count; i++) {
-    if (strcasecmp(manager->effects[i].name, name) == 0) {
-      return effect_manager_switch_to(manager, i);
-    }
+  int index = effect_manager_find_effect(manager, name);
+  if (index < 0) {
+    ESP_LOGE(TAG, "Effect not found: %s", name);
+    return ESP_ERR_NOT_FOUND;
   }
-
-  ESP_LOGE(TAG, "Effect not found: %s", name);
-  return ESP_ERR_NOT_FOUND;
+  return effect_manager_switch_to(manager, index);
 }
 
 void effect_manager_cleanup(effect_manager_t *manager) {
@@ -540,8 +663,14 @@ void effect_manager_cleanup(effect_manager_t *manager) {
 
   ESP_LOGI(TAG, "Cleaning up effect manager");
 
-  // Остановить текущий эффект
-  effect_manager_stop_current(manager);
+  // Остановить сохранение до задачи отрисовки, оно читает ее состояние
+  if (manager->control_save_task_handle) {
+    vTaskDelete(manager->control_save_task_handle);
+    manager->control_save_task_handle = NULL;
+  }
+
+  // Остановить задачу отрисовки
+  led_render_stop(manager->params);
 
   // Остановить задачу обработки кнопки
   if (manager->button_task_handle) {
@@ -582,7 +711,6 @@ void effect_manager_cleanup(effect_manager_t *manager) {
   manager->params = NULL;
   manager->effects = NULL;
   manager->effect_count = 0;
-  manager->current_effect = 0;
 
   ESP_LOGI(TAG, "Effect manager cleanup completed");
 }
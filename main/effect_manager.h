@@ -15,16 +15,6 @@
 extern "C" {
 #endif
 
-// Тип функции эффекта
-typedef void (*led_effect_func_t)(void *params);
-
-// Описание эффекта
-typedef struct {
-  const char *name;
-  led_effect_func_t func;
-  const char *description;
-} led_effect_info_t;
-
 // Параметры для задачи обработки secondary кнопки
 typedef struct {
   struct effect_manager_s *manager; // Forward declaration
@@ -47,14 +37,14 @@ typedef struct {
 // Менеджер эффектов
 typedef struct effect_manager_s {
   led_effect_params_t *params;
-  const led_effect_info_t *effects;
+  const led_effect_info_t *effects; // effect_registry
   int effect_count;
-  int current_effect;
   TaskHandle_t button_task_handle;
   TaskHandle_t button_secondary_task_handle;
   button_params_t *button_params;
   button_secondary_params_t *button_secondary_params;
   TaskHandle_t rotate_encoder_task_handle;
+  TaskHandle_t control_save_task_handle; // Saves the control state to NVS
   rotate_encoder_params_t *rotate_encoder_params_t;
 } effect_manager_t;
 
@@ -63,7 +53,6 @@ typedef struct {
   int current_effect;
   int total_effects;
   char current_name[32];
-  char effects_list[512]; // JSON-like string
 } effect_status_t;
 
 /**
@@ -105,11 +94,31 @@ esp_err_t effect_manager_start_physical_controls_handler(
 
 esp_err_t effect_manager_stop_current(effect_manager_t *manager);
 esp_err_t effect_manager_start_current(effect_manager_t *manager);
+esp_err_t effect_manager_toggle_running(effect_manager_t *manager);
 
 const char *effect_manager_get_current_name(effect_manager_t *manager);
 
 int effect_manager_get_current_index(effect_manager_t *manager);
 
+// Index of the effect with the id or name (case-insensitive), -1 if unknown
+int effect_manager_find_effect(effect_manager_t *manager, const char *name);
+
+// Index of the parameter of an effect (case-insensitive), -1 if unknown
+int effect_manager_find_param(effect_manager_t *manager, int effect_index,
+                              const char *name);
+
+/**
+ * @brief Set a tunable parameter of an effect
+ * @param manager Pointer to effect manager
+ * @param effect_index Effect, need not be the current one
+ * @param name Parameter name
+ * @param value New value, within the range of the parameter
+ * @return ESP_ERR_NOT_FOUND for an unknown parameter, ESP_ERR_INVALID_ARG
+ *         for a value out of range
+ */
+esp_err_t effect_manager_set_param(effect_manager_t *manager, int effect_index,
+                                   const char *name, int32_t value);
+
 esp_err_t effect_manager_get_status(effect_manager_t *manager,
                                     effect_status_t *status);
 
@@ -0,0 +1,82 @@
+/*
+ * Effect Registry Implementation
+ */
+
+#include "effect_registry.h"
+#include <string.h>
+#include <strings.h>
+
+// Определение всех доступных эффектов, порядок задает индексы
+const led_effect_info_t effect_registry[] = {
+    {.id = "soft_light",
+     .name = "Soft Light",
+     .description = "Soft light effect",
+     .render = soft_light_render_frame,
+     .fps = 40,
+     .params = soft_light_params,
+     .param_count = SOFT_LIGHT_PARAM_COUNT},
+    {.id = "fire",
+     .name = "Fire",
+     .description = "Fire simulation effect",
+     .init = fire_init,
+     .render = fire_render_frame,
+     .state_size = fire_state_size,
+     .fps = 24,
+     .params = fire_params,
+     .param_count = FIRE_PARAM_COUNT},
+    {.id = "firefly",
+     .name = "Firefly mode",
+     .description = "Firefly in the dark",
+     .init = firefly_init,
+     .render = firefly_render_frame,
+     .state_size = firefly_state_size,
+     .fps = 22,
+     .params = firefly_params,
+     .param_count = FIREFLY_PARAM_COUNT},
+    {.id = "stars",
+     .name = "Stars",
+     .description = "Starlight effect",
+     .init = stars_init,
+     .render = stars_render_frame,
+     .state_size = stars_state_size,
+     .fps = 20, // Smooth twinkling
+     .params = stars_params,
+     .param_count = STARS_PARAM_COUNT},
+    {.id = "rainbow",
+     .name = "Rainbow",
+     .description = "Slowly shifting rainbow",
+     .render = rainbow_render_frame,
+     .fps = 30,
+     .params = rainbow_params,
+     .param_count = RAINBOW_PARAM_COUNT},
+};
+
+const int effect_registry_count =
+    sizeof(effect_registry) / sizeof(effect_registry[0]);
+
+int effect_registry_find(const char *name) {
+  if (!name) {
+    return -1;
+  }
+  for (int i = 0; i < effect_registry_count; i++) {
+    if (strcasecmp(effect_registry[i].id, name) == 0 ||
+        strcasecmp(effect_registry[i].name, name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+size_t effect_registry_max_state_size(const render_geometry_t *geometry) {
+  size_t max_state_size = 0;
+  for (int i = 0; i < effect_registry_count; i++) {
+    if (!effect_registry[i].state_size) {
+      continue;
+    }
+    size_t size = effect_registry[i].state_size(geometry);
+    if (size > max_state_size) {
+      max_state_size = size;
+    }
+  }
+  return max_state_size;
+}
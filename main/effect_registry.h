@@ -0,0 +1,42 @@
+/*
+ * Effect Registry
+ *
+ * Every effect the firmware knows, with the metadata the rest of the code
+ * needs: name, description, parameter schema, frame rate and state size.
+ * The table is const data, its length is counted by the compiler, so
+ * adding an effect is one entry in effect_registry.c. The effect manager,
+ * the web API and the host tests all read this table. Pure data, also
+ * builds on a host.
+ */
+
+#ifndef EFFECT_REGISTRY_H
+#define EFFECT_REGISTRY_H
+
+#include "effect_render.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern const led_effect_info_t effect_registry[];
+extern const int effect_registry_count;
+
+/**
+ * @brief Find an effect by id or name, case-insensitive
+ * @param name Id ("soft_light") or name ("Soft Light")
+ * @return Index into effect_registry, -1 if unknown
+ */
+int effect_registry_find(const char *name);
+
+/**
+ * @brief Largest state any registered effect needs for a geometry
+ * @param geometry Matrix geometry
+ * @return Bytes, 0 if no effect keeps state
+ */
+size_t effect_registry_max_state_size(const render_geometry_t *geometry);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EFFECT_REGISTRY_H
@@ -0,0 +1,633 @@
+/*
+ * Effect Rendering Core Implementation
+ */
+
+#include "effect_render.h"
+#include "color_hsv.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if LED_SHOULD_ROUND == 1
+// Function to check if LED should be disabled for circular rounding.
+// corner_distance holds the distance of every LED from the matrix center
+// relative to the corner distance, 0.16 fixed point.
+static inline bool is_corner_led(const render_geometry_t *geometry,
+                                 int led_index, uint16_t threshold) {
+  return geometry->corner_distance[led_index] > threshold;
+}
+
+#endif
+
+// xorshift32 cannot leave the all-zero state, so it is never seeded with 0
+#define RENDER_RANDOM_DEFAULT_SEED 2463534242u
+
+static uint32_t random_state = RENDER_RANDOM_DEFAULT_SEED;
+
+void render_random_seed(uint32_t seed) {
+  random_state = seed ? seed : RENDER_RANDOM_DEFAULT_SEED;
+}
+
+uint32_t render_random(void) {
+  uint32_t x = random_state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  random_state = x;
+  return x;
+}
+
+size_t render_tables_size(const render_geometry_t *geometry) {
+#if LED_SHOULD_ROUND == 1
+  return (size_t)geometry->width * geometry->height * sizeof(uint16_t);
+#else
+  (void)geometry;
+  return 0;
+#endif
+}
+
+void render_init(render_geometry_t *geometry, void *tables) {
+  geometry->count = geometry->width * geometry->height;
+  geometry->corner_distance = NULL;
+#if LED_SHOULD_ROUND == 1
+  geometry->corner_distance = (uint16_t *)tables;
+
+  // Calculate distance from center for each LED
+  float center_x = (geometry->width - 1) / 2.0f;
+  float center_y = (geometry->height - 1) / 2.0f;
+  float max_radius = sqrtf(center_x * center_x + center_y * center_y);
+  if (max_radius == 0.0f) {
+    max_radius = 1.0f; // Single LED
+  }
+
+  for (int i = 0; i < geometry->count; i++) {
+    float dx = i % geometry->width - center_x;
+    float dy = i / geometry->width - center_y;
+    float ratio = sqrtf(dx * dx + dy * dy) / max_radius;
+    geometry->corner_distance[i] = (uint16_t)(ratio * UINT16_MAX + 0.5f);
+  }
+#else
+  (void)tables;
+#endif
+}
+
+// Corner rounding threshold grows from start to target in fixed steps.
+// Thresholds are 16.16 fractions below 1.0, the scale of corner_distance.
+static inline uint16_t ramp_threshold(uint32_t t, q16_16_t start,
+                                      q16_16_t target, q16_16_t step) {
+  int64_t threshold = start + (int64_t)step * (t + 1);
+  return (uint16_t)(threshold > target ? target : threshold);
+}
+
+// The ramp moves the corner mask until the threshold reaches its target
+static inline bool ramp_moved(uint32_t t, q16_16_t start, q16_16_t target,
+                              q16_16_t step) {
+  return t == 0 || ramp_threshold(t - 1, start, target, step) !=
+                       ramp_threshold(t, start, target, step);
+}
+
+static inline void set_pixel(render_frame_t *frame, int i, uint32_t red,
+                             uint32_t green, uint32_t blue) {
+  frame->pixels[i * 3 + 0] = red;
+  frame->pixels[i * 3 + 1] = green;
+  frame->pixels[i * 3 + 2] = blue;
+}
+
+void render_clear(render_frame_t *frame) {
+  memset(frame->pixels, 0, frame->geometry->count * 3);
+}
+
+void effect_params_reset(const led_effect_info_t *effect, int32_t *values) {
+  for (int i = 0; i < EFFECT_MAX_PARAMS; i++) {
+    values[i] = i < effect->param_count ? effect->params[i].def : 0;
+  }
+}
+
+// Value of a parameter for this frame
+static inline int32_t frame_param(const render_frame_t *frame,
+                                  const effect_param_info_t *params,
+                                  int index) {
+  return frame->params ? frame->params[index] : params[index].def;
+}
+
+// Цвета: черный фон, желтый светлячек
+#define FIREFLY_SATURATION 255
+#define FIREFLY_MAX_BRIGHTNESS 255
+
+// Random flicker interval, 0.5-3.0 s in frames of 20 ms
+#define FIREFLY_FLICKER_INTERVAL_MIN 25
+#define FIREFLY_FLICKER_INTERVAL_MAX 150
+
+enum { FIREFLY_SPEED, FIREFLY_SIZE, FIREFLY_HUE };
+
+const effect_param_info_t firefly_params[FIREFLY_PARAM_COUNT] = {
+    [FIREFLY_SPEED] = {"speed", EFFECT_PARAM_INT, 10, 400, 100}, // %
+    [FIREFLY_SIZE] = {"size", EFFECT_PARAM_INT, 10, 50, 40}, // % of matrix
+    [FIREFLY_HUE] = {"hue", EFFECT_PARAM_INT, 0, 359, 20},   // degrees
+};
+
+size_t firefly_state_size(const render_geometry_t *geometry) {
+  (void)geometry;
+  return sizeof(firefly_state_t);
+}
+
+void firefly_init(void *state, const render_geometry_t *geometry) {
+  firefly_state_t *s = (firefly_state_t *)state;
+  (void)geometry;
+  memset(s, 0, sizeof(*s));
+  s->next_random_flicker = FIREFLY_FLICKER_INTERVAL_MIN;
+}
+
+void firefly_render_frame(void *state, uint32_t t, render_frame_t *frame) {
+  firefly_state_t *s = (firefly_state_t *)state;
+  const render_geometry_t *geometry = frame->geometry;
+  uint8_t red, green, blue;
+  (void)t;
+
+  const q16_16_t firefly_size_min = Q16_16(1.5); // минимальный размер
+  const q16_16_t firefly_size_max = Q16_16(3.5); // максимальный размер
+  // скорость изменения размера
+  const fx_angle_t size_change_speed = FX_ANGLE(0.03);
+  const fx_angle_t movement_speed =
+      FX_ANGLE(0.05) * frame_param(frame, firefly_params, FIREFLY_SPEED) / 100;
+  const q16_16_t center_x = (geometry->width - 1) * Q16_16_ONE / 2;
+  const q16_16_t center_y = (geometry->height - 1) * Q16_16_ONE / 2;
+  // Share of the matrix size in percent
+  const int32_t figure8_size = frame_param(frame, firefly_params, FIREFLY_SIZE);
+  const q16_16_t figure8_half_width =
+      geometry->width * Q16_16_ONE * figure8_size / 100;
+  const q16_16_t figure8_half_height =
+      geometry->height * Q16_16_ONE * figure8_size / 100;
+  const uint8_t hue =
+      HSV8_HUE_DEG(frame_param(frame, firefly_params, FIREFLY_HUE));
+  // Скорость мерцания 0.1 - 0.3, медленно меняется
+  const fx_angle_t flicker_speed_min = FX_ANGLE(0.1);
+  const fx_angle_t flicker_speed_range = FX_ANGLE(0.2);
+  const fx_angle_t flicker_variation_speed = FX_ANGLE(0.014);
+  // Быстрые микро-мерцания
+  const fx_angle_t micro_flicker_speed = FX_ANGLE(0.8);
+  const q16_16_t micro_flicker_amount = Q16_16(0.15); // Интенсивность
+
+  // Обновляем фазы движения и изменения размера
+  s->movement_phase += movement_speed;
+  s->size_phase += size_change_speed;
+
+  q16_16_t firefly_size =
+      q16_16_mul((firefly_size_max - firefly_size_min) / 2,
+                 fx_sin(s->size_phase) + Q16_16_ONE) +
+      firefly_size_min;
+
+  // Обновляем случайное мерцание
+  if (++s->random_flicker_timer >= s->next_random_flicker) {
+    s->random_flicker_timer = 0;
+    s->is_random_dim = !s->is_random_dim;
+
+    // Следующий интервал мерцания случайный
+    s->next_random_flicker =
+        FIREFLY_FLICKER_INTERVAL_MIN +
+        render_random() %
+            (FIREFLY_FLICKER_INTERVAL_MAX - FIREFLY_FLICKER_INTERVAL_MIN + 1);
+  }
+
+  s->flicker_variation_phase += flicker_variation_speed;
+  q16_16_t flicker_variation =
+      (fx_sin(s->flicker_variation_phase) + Q16_16_ONE) / 2; // 0.0 - 1.0
+  fx_angle_t flicker_speed =
+      flicker_speed_min +
+      (fx_angle_t)((flicker_speed_range * flicker_variation) >> 16);
+
+  s->micro_flicker_phase += micro_flicker_speed;
+  q16_16_t micro_flicker =
+      q16_16_mul(fx_sin(s->micro_flicker_phase), micro_flicker_amount);
+
+  // Восьмерка - единственный режим движения
+  q16_16_t move_sin = fx_sin(s->movement_phase);
+  q16_16_t firefly_x = center_x + q16_16_mul(figure8_half_width, move_sin);
+  q16_16_t firefly_y =
+      center_y + q16_16_mul(q16_16_mul(figure8_half_height, move_sin),
+                            fx_cos(s->movement_phase));
+
+  // Обновляем мерцание
+  s->flicker_phase += flicker_speed;
+
+  // Яркость светлячка с мерцанием
+  q16_16_t flicker = (fx_sin(s->flicker_phase) + Q16_16_ONE) / 2;
+
+  // Добавляем микро-мерцания для большей естественности
+  flicker += micro_flicker;
+  if (flicker < Q16_16(0.3))
+    flicker = Q16_16(0.3); // Минимальная яркость
+  if (flicker > Q16_16_ONE)
+    flicker = Q16_16_ONE; // Максимальная яркость
+
+  if (s->is_random_dim) {
+    flicker /= 2; // Dim by 50% during random flickering
+  }
+
+  uint32_t firefly_brightness = (FIREFLY_MAX_BRIGHTNESS * flicker) >> 16;
+  frame->changed = true; // Moves and flickers every frame
+
+  // Per-pixel math in 8.8: squared distances are 16.16 and fx_isqrt()
+  // of them is the 8.8 distance. The reciprocal of the size replaces a
+  // division per lit pixel.
+  int32_t fx = firefly_x >> 8;
+  int32_t fy = firefly_y >> 8;
+  uint32_t size = firefly_size >> 8;
+  uint32_t size_sq = size * size;
+  uint32_t inv_size = (1UL << 16) / size;
+
+#if LED_SHOULD_ROUND == 1
+  const uint16_t threshold = Q16_16(0.95);
+#endif
+
+  for (int j = 0; j < geometry->count; j++) {
+#if LED_SHOULD_ROUND == 1
+    if (is_corner_led(geometry, j, threshold)) {
+      // Отключаем угловые светодиоды
+      set_pixel(frame, j, 0, 0, 0);
+      continue;
+    }
+#endif
+
+    // Переводим 1D индекс в 2D координаты
+    int row = j / geometry->width;
+    int col = j % geometry->width;
+
+    int32_t dx = (col << 8) - fx;
+    int32_t dy = (row << 8) - fy;
+    // Box test first: on wide matrices far pixels would overflow the square
+    uint32_t distance_sq = size_sq + 1;
+    if ((uint32_t)abs(dx) <= size && (uint32_t)abs(dy) <= size) {
+      distance_sq = (uint32_t)(dx * dx) + (uint32_t)(dy * dy);
+    }
+
+    if (distance_sq <= size_sq) {
+      // Светлячек - плавное затухание от центра
+      uint32_t distance = fx_isqrt(distance_sq);
+      int32_t intensity = Q8_8_ONE - (int32_t)((distance * inv_size) >> 8);
+      if (intensity < 0)
+        intensity = 0;
+      intensity = (intensity * intensity) >> 8; // квадратичное затухание
+
+      uint8_t brightness = (firefly_brightness * intensity) >> 8;
+      hsv8_t color = {hue, FIREFLY_SATURATION, brightness};
+      hsv8_to_rgb(color, &red, &green, &blue);
+    } else {
+      // Фон - черный
+      red = 0;
+      green = 0;
+      blue = 0;
+    }
+
+    set_pixel(frame, j, red, green, blue);
+  }
+}
+
+enum { FIRE_COOLING, FIRE_COOLING_RANGE, FIRE_SPARKS };
+
+const effect_param_info_t fire_params[FIRE_PARAM_COUNT] = {
+    // Heat every cell loses per frame: cooling + random below cooling_range
+    [FIRE_COOLING] = {"cooling", EFFECT_PARAM_INT, 0, 50, 5},
+    [FIRE_COOLING_RANGE] = {"cooling_range", EFFECT_PARAM_INT, 1, 50, 10},
+    // Chance of a spark per bottom cell in tenths
+    [FIRE_SPARKS] = {"sparks", EFFECT_PARAM_INT, 0, 10, 5},
+};
+
+size_t fire_state_size(const render_geometry_t *geometry) {
+  return sizeof(fire_state_t) + (size_t)geometry->width * geometry->height;
+}
+
+void fire_init(void *state, const render_geometry_t *geometry) {
+  fire_state_t *s = (fire_state_t *)state;
+  s->count = geometry->count;
+  memset(s->heat, 0, s->count);
+}
+
+void fire_render_frame(void *state, uint32_t t, render_frame_t *frame) {
+  fire_state_t *s = (fire_state_t *)state;
+  const render_geometry_t *geometry = frame->geometry;
+  const int width = geometry->width;
+  uint8_t *heat = s->heat; // heat[row * width + col]
+  uint32_t red, green, blue;
+  const uint32_t cooling_min = frame_param(frame, fire_params, FIRE_COOLING);
+  const uint32_t cooling_range =
+      frame_param(frame, fire_params, FIRE_COOLING_RANGE);
+  const uint32_t sparks = frame_param(frame, fire_params, FIRE_SPARKS);
+#if LED_SHOULD_ROUND == 1
+  uint16_t threshold = ramp_threshold(t, Q16_16(0.1), Q16_16(0.8),
+                                      Q16_16((0.8 - 0.1) / (10 / 5)));
+#else
+  (void)t;
+#endif
+
+  // Step 1: Cool down every cell
+  for (int i = 0; i < s->count; i++) {
+    uint8_t cooling = (render_random() % cooling_range) + cooling_min;
+    if (cooling > heat[i]) {
+      heat[i] = 0;
+    } else {
+      heat[i] -= cooling;
+    }
+  }
+
+  // Step 2: Heat propagation: 80% от нижнего + 20% от текущего
+  for (int row = geometry->height - 1; row > 0; row--) {
+    for (int col = 0; col < width; col++) {
+      int i = row * width + col;
+      heat[i] = (heat[i - width] * 8 + heat[i] * 2) / 10;
+    }
+  }
+
+  // Step 3: Add new sparks at the bottom row
+  for (int col = 0; col < width; col++) {
+    if (render_random() % 10 < sparks) {
+      uint8_t spark = 180 + (render_random() % 76); // 180-255
+      if (spark > heat[col]) {
+        heat[col] = spark;
+      }
+    }
+  }
+
+  // Step 4: ЧИСТАЯ ОГНЕННАЯ ПАЛИТРА БЕЗ СИНЕГО
+  frame->changed = true; // Sparks are random every frame
+  for (int i = 0; i < s->count; i++) {
+#if LED_SHOULD_ROUND == 1
+    if (is_corner_led(geometry, i, threshold)) {
+      // Disable corner LEDs
+      set_pixel(frame, i, 0, 0, 0);
+      continue;
+    }
+#endif
+
+    // Чистая огненная палитра: черный → красный → оранжевый
+    uint8_t heat_val = heat[i];
+
+    if (heat_val < 85) {    // Черный → темно-красный
+      red = heat_val * 3;   // 0-255
+      green = heat_val / 4; // 0-21 (очень мало зеленого)
+      blue = 0;
+    } else if (heat_val < 170) { // Темно-красный → ярко-красный
+      red = 255;
+      green = (heat_val - 85) * 1; // 0-170 (умеренный зеленый)
+      blue = 0;
+    } else { // Красный → оранжевый → желтый
+      red = 255;
+      green = 140 + (heat_val - 170) / 2; // 170-255
+      blue = 0;
+    }
+
+    set_pixel(frame, i, red, green, blue);
+  }
+}
+
+// Random 16.16 fraction in [base, base + range / scale)
+static inline q16_16_t random_fraction(q16_16_t base, uint32_t range,
+                                       uint32_t scale) {
+  return base + (q16_16_t)(((render_random() % range) << 16) / scale);
+}
+
+// Star timers count frames of 50 ms, random delays are given in ms
+#define STARS_FRAME_MS 50
+#define STARS_DELAY(min_ms, range_ms)                                          \
+  (((min_ms) + render_random() % (range_ms)) / STARS_FRAME_MS)
+
+// Up to 25% of LEDs can be stars
+static inline uint16_t stars_count(const render_geometry_t *geometry) {
+  return (uint16_t)((uint32_t)geometry->width * geometry->height / 4);
+}
+
+static inline bool star_visible(const star_t *star) {
+  return star->active && star->brightness > Q16_16(0.01);
+}
+
+enum { STARS_CHANCE };
+
+const effect_param_info_t stars_params[STARS_PARAM_COUNT] = {
+    // Chance of a dark star to light up when its timer runs out, percent
+    [STARS_CHANCE] = {"chance", EFFECT_PARAM_INT, 0, 100, 15},
+};
+
+size_t stars_state_size(const render_geometry_t *geometry) {
+  return sizeof(stars_state_t) + stars_count(geometry) * sizeof(star_t);
+}
+
+void stars_init(void *state, const render_geometry_t *geometry) {
+  stars_state_t *s = (stars_state_t *)state;
+  s->count = stars_count(geometry);
+
+  for (int i = 0; i < s->count; i++) {
+    star_t *star = &s->stars[i];
+    star->position = render_random() % geometry->count;
+    star->brightness = 0;
+    star->target_brightness = 0;
+    star->fade_speed = random_fraction(Q16_16(0.01), 30, 1000); // 0.01-0.04
+    star->active = false;
+    star->color_type = render_random() % 3;
+    star->timer = 0;
+    star->next_change = STARS_DELAY(0, 3000); // 0-3 seconds
+  }
+}
+
+void stars_render_frame(void *state, uint32_t t, render_frame_t *frame) {
+  stars_state_t *s = (stars_state_t *)state;
+  const render_geometry_t *geometry = frame->geometry;
+  uint32_t red, green, blue;
+  const uint32_t chance = frame_param(frame, stars_params, STARS_CHANCE);
+#if LED_SHOULD_ROUND == 1
+  // Gradually increase corner rounding threshold
+  uint16_t threshold = ramp_threshold(t, Q16_16(0.1), Q16_16(0.95),
+                                      Q16_16((0.95 - 0.1) / (100 / 5)));
+  frame->changed = ramp_moved(t, Q16_16(0.1), Q16_16(0.95),
+                              Q16_16((0.95 - 0.1) / (100 / 5)));
+#else
+  frame->changed = t == 0;
+#endif
+
+  // Update stars
+  for (int i = 0; i < s->count; i++) {
+    star_t *star = &s->stars[i];
+    const star_t before = *star;
+
+    // Check if it's time to change star state
+    if (++star->timer >= star->next_change) {
+      star->timer = 0;
+
+      if (star->active && star->target_brightness > Q16_16(0.1)) {
+        // Start fading out
+        star->target_brightness = 0;
+        star->next_change = STARS_DELAY(1000, 2000); // 1-3s
+      } else if (render_random() % 100 < chance) {
+        star->active = true;
+        star->position = render_random() % geometry->count;
+        star->target_brightness =
+            random_fraction(Q16_16(0.3), 70, 100); // 0.3-1.0
+        star->color_type = render_random() % 3;
+        star->fade_speed =
+            random_fraction(Q16_16(0.008), 25, 1000); // 0.008-0.033
+        star->next_change = STARS_DELAY(2000, 4000); // 2-6s
+      } else {
+        star->next_change = STARS_DELAY(500, 1500); // 0.5-2s
+      }
+    }
+
+    // Update brightness towards target
+    if (star->brightness < star->target_brightness) {
+      star->brightness += star->fade_speed;
+      if (star->brightness > star->target_brightness) {
+        star->brightness = star->target_brightness;
+      }
+    } else if (star->brightness > star->target_brightness) {
+      star->brightness -= star->fade_speed;
+      if (star->brightness < star->target_brightness) {
+        star->brightness = star->target_brightness;
+      }
+    }
+
+    // Deactivate completely faded stars
+    if (star->brightness <= Q16_16(0.01)) {
+      star->active = false;
+      star->brightness = 0;
+    }
+
+    // Most of the time stars hold their brightness or stay dark
+    if (star_visible(&before) != star_visible(star) ||
+        (star_visible(star) && (before.position != star->position ||
+                                before.brightness != star->brightness ||
+                                before.color_type != star->color_type))) {
+      frame->changed = true;
+    }
+  }
+
+  // Clear all LEDs to black background
+  render_clear(frame);
+
+  // Render active stars
+  for (int i = 0; i < s->count; i++) {
+    const star_t *star = &s->stars[i];
+    if (!star_visible(star)) {
+      continue;
+    }
+
+    int pos = star->position;
+
+#if LED_SHOULD_ROUND == 1
+    if (is_corner_led(geometry, pos, threshold)) {
+      continue; // Skip corner LEDs
+    }
+#endif
+
+    // Set star color based on type
+    uint32_t base_brightness = (255 * star->brightness) >> 16;
+
+    switch (star->color_type) {
+    case 0: // Cool white
+      red = base_brightness;
+      green = base_brightness;
+      blue = (base_brightness * Q8_8(1.2)) >> 8;
+      if (blue > 255)
+        blue = 255;
+      break;
+    case 1: // Warm white
+      red = base_brightness;
+      green = (base_brightness * Q8_8(0.8)) >> 8;
+      blue = (base_brightness * Q8_8(0.4)) >> 8;
+      break;
+    case 2: // Blue-white
+      red = (base_brightness * Q8_8(0.8)) >> 8;
+      green = (base_brightness * Q8_8(0.9)) >> 8;
+      blue = base_brightness;
+      break;
+    default:
+      red = green = blue = base_brightness;
+      break;
+    }
+
+    set_pixel(frame, pos, red, green, blue);
+  }
+}
+
+enum { SOFT_LIGHT_COLOR };
+
+const effect_param_info_t soft_light_params[SOFT_LIGHT_PARAM_COUNT] = {
+    // Теплый белый ~2300K, после гамма-коррекции 255/115/23
+    [SOFT_LIGHT_COLOR] = {"color", EFFECT_PARAM_COLOR, 0, 0xFFFFFF, 0xFFB255},
+};
+
+void soft_light_render_frame(void *state, uint32_t t, render_frame_t *frame) {
+  const render_geometry_t *geometry = frame->geometry;
+  const uint32_t color = frame_param(frame, soft_light_params,
+                                     SOFT_LIGHT_COLOR);
+  const uint32_t red = color >> 16;
+  const uint32_t green = (color >> 8) & 0xFF;
+  const uint32_t blue = color & 0xFF;
+  (void)state;
+#if LED_SHOULD_ROUND == 1
+  uint16_t threshold = ramp_threshold(t, Q16_16(0.1), Q16_16(0.8),
+                                      Q16_16((0.8 - 0.1) / 5));
+  // Static once the corners are rounded
+  frame->changed =
+      ramp_moved(t, Q16_16(0.1), Q16_16(0.8), Q16_16((0.8 - 0.1) / 5));
+#else
+  frame->changed = t == 0;
+#endif
+
+  for (int i = 0; i < geometry->count; i++) {
+#if LED_SHOULD_ROUND == 1
+    if (is_corner_led(geometry, i, threshold)) {
+      // Disable corner LEDs
+      set_pixel(frame, i, 0, 0, 0);
+      continue;
+    }
+#endif
+
+    set_pixel(frame, i, red, green, blue);
+  }
+}
+
+#define RAINBOW_BATCH 16 // Colors converted per call
+
+enum { RAINBOW_SPEED, RAINBOW_SPREAD };
+
+// Hue steps per frame and between neighbouring diagonals
+const effect_param_info_t rainbow_params[RAINBOW_PARAM_COUNT] = {
+    [RAINBOW_SPEED] = {"speed", EFFECT_PARAM_INT, 0, 16, 1},
+    [RAINBOW_SPREAD] = {"spread", EFFECT_PARAM_INT, 0, 64, 12},
+};
+
+void rainbow_render_frame(void *state, uint32_t t, render_frame_t *frame) {
+  const render_geometry_t *geometry = frame->geometry;
+  hsv8_t colors[RAINBOW_BATCH];
+  (void)state;
+
+  // Rainbow runs along the diagonal and shifts its hue every frame
+  const uint32_t spread = frame_param(frame, rainbow_params, RAINBOW_SPREAD);
+  uint8_t hue =
+      (uint8_t)(t * frame_param(frame, rainbow_params, RAINBOW_SPEED));
+  frame->changed = true;
+  for (int row = 0; row < geometry->height; row++) {
+    for (int start = 0; start < geometry->width; start += RAINBOW_BATCH) {
+      int count = geometry->width - start;
+      if (count > RAINBOW_BATCH) {
+        count = RAINBOW_BATCH;
+      }
+      for (int n = 0; n < count; n++) {
+        colors[n] = (hsv8_t){
+            .h = (uint8_t)(hue + (row + start + n) * spread),
+            .s = 255,
+            .v = 255,
+        };
+      }
+      int first = row * geometry->width + start;
+      hsv8_row_to_pixels(colors, &frame->pixels[first * 3], count);
+    }
+  }
+
+#if LED_SHOULD_ROUND == 1
+  const uint16_t threshold = Q16_16(0.95);
+  for (int i = 0; i < geometry->count; i++) {
+    if (is_corner_led(geometry, i, threshold)) {
+      set_pixel(frame, i, 0, 0, 0);
+    }
+  }
+#endif
+}
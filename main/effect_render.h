@@ -0,0 +1,196 @@
+/*
+ * Effect Rendering Core
+ *
+ * Pure per-frame renderers for LED effects. Nothing here depends on
+ * FreeRTOS or ESP-IDF drivers, so the module also builds on a host.
+ */
+
+#ifndef EFFECT_RENDER_H
+#define EFFECT_RENDER_H
+
+#include "fixed_math.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Configuration constants
+#define LED_DEFAULT_WIDTH 8  // Geometry used when none is stored in NVS
+#define LED_DEFAULT_HEIGHT 8
+#define LED_MAX_COUNT 1024   // Upper bound for width * height
+#define LED_SHOULD_ROUND 1 // Will round active leds to pretend a circle
+
+// Matrix geometry, LEDs are numbered row by row
+typedef struct {
+  uint16_t width;            // LEDs per row
+  uint16_t height;           // Rows
+  uint16_t count;            // width * height
+  uint16_t *corner_distance; // Round mask table, built by render_init()
+} render_geometry_t;
+
+#define EFFECT_MAX_PARAMS 4 // Tunable parameters per effect
+
+typedef enum {
+  EFFECT_PARAM_INT,   // Integer in [min, max]
+  EFFECT_PARAM_COLOR, // RGB as 0xRRGGBB
+} effect_param_type_t;
+
+// Tunable parameter of an effect. Renderers read the value at the index of
+// the descriptor, the range is checked before a value reaches them.
+typedef struct {
+  const char *name;
+  effect_param_type_t type;
+  int32_t min;
+  int32_t max;
+  int32_t def; // Reproduces the look of the effect before it was tunable
+} effect_param_info_t;
+
+// Frame being rendered (RGB, 3 bytes per pixel). Effects render at full
+// scale, brightness and gamma are applied later by the output stage and
+// the pack stage converts the frame to the wire format of the strip.
+// Every frame is drawn in full. The caller clears changed before a frame
+// and the effect sets it unless the pixels equal those of its previous
+// frame, so static scenes are neither packed nor sent.
+typedef struct {
+  uint8_t *pixels; // geometry->count * 3 bytes
+  const render_geometry_t *geometry;
+  bool changed; // Set by the effect when the frame differs from the last
+  const int32_t *params; // Parameter values, NULL renders the defaults
+} render_frame_t;
+
+// Renderer callbacks: t is the frame number since the effect was started
+typedef size_t (*effect_state_size_fn_t)(const render_geometry_t *geometry);
+typedef void (*effect_init_fn_t)(void *state,
+                                 const render_geometry_t *geometry);
+typedef void (*effect_render_fn_t)(void *state, uint32_t t,
+                                   render_frame_t *frame);
+
+// Описание эффекта, все эффекты перечислены в effect_registry.c
+typedef struct {
+  const char *id;   // Short name for URLs and files, [a-z0-9_]
+  const char *name; // Shown to the user
+  const char *description;
+  effect_init_fn_t init;     // NULL if the effect keeps no state
+  effect_render_fn_t render;
+  effect_state_size_fn_t state_size; // Bytes of state, NULL if none
+  uint16_t fps;              // Target frame rate
+  const effect_param_info_t *params; // Tunable parameters, may be NULL
+  uint8_t param_count;       // Up to EFFECT_MAX_PARAMS
+} led_effect_info_t;
+
+/**
+ * @brief Seed the random source used by renderers
+ *
+ * Renderers draw from a xorshift32 generator, a few instructions per
+ * number instead of a wait on the hardware RNG. The device seeds it from
+ * esp_random() once; the same seed gives the same frames on any platform.
+ *
+ * @param seed Seed, 0 selects a fixed default
+ */
+void render_random_seed(uint32_t seed);
+
+/**
+ * @brief Next number of the renderer random source
+ * @return Pseudo random 32-bit value, never 0
+ */
+uint32_t render_random(void);
+
+typedef struct {
+  fx_angle_t size_phase;
+  fx_angle_t movement_phase;
+  fx_angle_t flicker_phase;
+  fx_angle_t flicker_variation_phase;
+  fx_angle_t micro_flicker_phase;
+  uint16_t random_flicker_timer; // Frames since the last random flicker
+  uint16_t next_random_flicker;  // Frames until the next random flicker
+  bool is_random_dim;
+} firefly_state_t;
+
+typedef struct {
+  uint16_t count;  // Cells in heat
+  uint8_t heat[]; // One cell per LED, row by row
+} fire_state_t;
+
+typedef struct {
+  uint16_t position;          // LED index
+  q16_16_t brightness;        // Current brightness (0.0 - 1.0)
+  q16_16_t target_brightness; // Target brightness
+  q16_16_t fade_speed;        // Brightness change per frame
+  uint16_t timer;             // Frames since the last state change
+  uint16_t next_change;       // Frames until the next state change
+  uint8_t color_type;         // 0=cool white, 1=warm white, 2=blue-white
+  bool active;                // Is this star active
+} star_t;
+
+typedef struct {
+  uint16_t count;  // Up to 25% of LEDs can be stars
+  star_t stars[];
+} stars_state_t;
+
+// Parameters of the effects, referenced from the registry
+#define FIREFLY_PARAM_COUNT 3
+#define FIRE_PARAM_COUNT 3
+#define STARS_PARAM_COUNT 1
+#define SOFT_LIGHT_PARAM_COUNT 1
+#define RAINBOW_PARAM_COUNT 2
+extern const effect_param_info_t firefly_params[FIREFLY_PARAM_COUNT];
+extern const effect_param_info_t fire_params[FIRE_PARAM_COUNT];
+extern const effect_param_info_t stars_params[STARS_PARAM_COUNT];
+extern const effect_param_info_t soft_light_params[SOFT_LIGHT_PARAM_COUNT];
+extern const effect_param_info_t rainbow_params[RAINBOW_PARAM_COUNT];
+
+size_t firefly_state_size(const render_geometry_t *geometry);
+void firefly_init(void *state, const render_geometry_t *geometry);
+void firefly_render_frame(void *state, uint32_t t, render_frame_t *frame);
+
+size_t fire_state_size(const render_geometry_t *geometry);
+void fire_init(void *state, const render_geometry_t *geometry);
+void fire_render_frame(void *state, uint32_t t, render_frame_t *frame);
+
+size_t stars_state_size(const render_geometry_t *geometry);
+void stars_init(void *state, const render_geometry_t *geometry);
+void stars_render_frame(void *state, uint32_t t, render_frame_t *frame);
+
+void soft_light_render_frame(void *state, uint32_t t, render_frame_t *frame);
+
+void rainbow_render_frame(void *state, uint32_t t, render_frame_t *frame);
+
+/**
+ * @brief Bytes of lookup tables render_init() builds for a geometry
+ * @param geometry Matrix geometry
+ * @return Size of the tables buffer, may be 0
+ */
+size_t render_tables_size(const render_geometry_t *geometry);
+
+/**
+ * @brief Build lookup tables shared by all renderers
+ *
+ * Must be called once before the first frame is rendered. Sets count from
+ * width and height and points the tables of the geometry into the buffer.
+ *
+ * @param geometry Matrix geometry with width and height set
+ * @param tables render_tables_size() bytes, aligned for uint16_t, must
+ *               outlive the geometry
+ */
+void render_init(render_geometry_t *geometry, void *tables);
+
+/**
+ * @brief Set the parameter values of an effect to their defaults
+ * @param effect Effect
+ * @param values EFFECT_MAX_PARAMS values, those past param_count become 0
+ */
+void effect_params_reset(const led_effect_info_t *effect, int32_t *values);
+
+/**
+ * @brief Fill the frame with black
+ */
+void render_clear(render_frame_t *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EFFECT_RENDER_H
@@ -0,0 +1,79 @@
+/*
+ * Fixed-Point Math
+ *
+ * Integer replacements for the float math used by effects. The ESP32-C3
+ * has no FPU, every float operation there is a software library call.
+ *
+ *   q8_8_t    signed 8.8, colors, sizes and coordinates of small matrices
+ *   q16_16_t  signed 16.16, general purpose values and sin/cos results
+ *   fx_angle_t  full turn is 65536, wraps around for free
+ */
+
+#ifndef FIXED_MATH_H
+#define FIXED_MATH_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int16_t q8_8_t;
+typedef int32_t q16_16_t;
+typedef uint16_t fx_angle_t;
+
+#define Q8_8_ONE 256
+#define Q16_16_ONE 65536
+
+// Conversions of constants, evaluated by the compiler
+#define Q8_8(x) ((q8_8_t)((x) * 256.0 + ((x) >= 0 ? 0.5 : -0.5)))
+#define Q16_16(x) ((q16_16_t)((x) * 65536.0 + ((x) >= 0 ? 0.5 : -0.5)))
+#define FX_ANGLE(radians)                                                      \
+  ((fx_angle_t)((radians) * (65536.0 / 6.283185307179586) + 0.5))
+
+static inline q8_8_t q8_8_mul(q8_8_t a, q8_8_t b) {
+  return (q8_8_t)(((int32_t)a * b) >> 8);
+}
+
+static inline q16_16_t q16_16_mul(q16_16_t a, q16_16_t b) {
+  return (q16_16_t)(((int64_t)a * b) >> 16);
+}
+
+// a + (b - a) * t, t is 0..Q16_16_ONE
+static inline q16_16_t q16_16_lerp(q16_16_t a, q16_16_t b, q16_16_t t) {
+  return a + q16_16_mul(b - a, t);
+}
+
+// a + (b - a) * t / 256, t is 0..255
+static inline uint8_t lerp8(uint8_t a, uint8_t b, uint8_t t) {
+  return (uint8_t)(a + ((((int32_t)b - a) * t) >> 8));
+}
+
+// Scales an 8-bit value by an 8-bit fraction, scale8(x, 255) == x
+static inline uint8_t scale8(uint8_t value, uint8_t scale) {
+  return (uint8_t)(((uint16_t)value * (1 + scale)) >> 8);
+}
+
+/**
+ * @brief Sine from a 256 entry table with linear interpolation
+ * @param angle Angle, 65536 is a full turn
+ * @return Sine in 16.16, -1.0 .. 1.0
+ */
+q16_16_t fx_sin(fx_angle_t angle);
+
+static inline q16_16_t fx_cos(fx_angle_t angle) {
+  return fx_sin((fx_angle_t)(angle + 16384));
+}
+
+/**
+ * @brief Integer square root, floor(sqrt(value))
+ *
+ * The root of a 16.16 square is the 8.8 length.
+ */
+uint32_t fx_isqrt(uint32_t value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FIXED_MATH_H
@@ -0,0 +1,26 @@
+/*
+ * Frame Clock Implementation
+ */
+
+#include "frame_clock.h"
+
+void frame_clock_start(frame_clock_t *clock, uint32_t fps, uint64_t now_us) {
+  clock->period_us = 1000000ULL / (fps ? fps : 1);
+  clock->deadline_us = now_us;
+  clock->frames = 0;
+  // dropped_frames keeps counting across effect switches and pauses
+}
+
+uint64_t frame_clock_next(frame_clock_t *clock, uint64_t now_us) {
+  clock->frames++;
+  clock->deadline_us += clock->period_us;
+
+  if (now_us > clock->deadline_us) {
+    // Skip the slots we are already past but stay aligned to the grid
+    uint64_t missed = (now_us - clock->deadline_us) / clock->period_us + 1;
+    clock->dropped_frames += (uint32_t)missed;
+    clock->deadline_us += missed * clock->period_us;
+  }
+
+  return clock->deadline_us - now_us;
+}
@@ -0,0 +1,53 @@
+/*
+ * Frame Clock
+ *
+ * Deadline based frame pacing. Frame start times stay on a fixed grid of
+ * 1/fps seconds, so render cost and timer granularity do not accumulate
+ * into drift. Pure logic, time is passed in by the caller.
+ */
+
+#ifndef FRAME_CLOCK_H
+#define FRAME_CLOCK_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  uint64_t period_us;      // Frame period
+  uint64_t deadline_us;    // Start time of the next frame
+  uint32_t frames;         // Frames paced since start
+  uint32_t dropped_frames; // Frame slots missed since boot, cumulative
+} frame_clock_t;
+
+/**
+ * @brief Start pacing frames at the given rate
+ *
+ * Restarts the grid and the frame count. dropped_frames is left alone, it
+ * counts over every start; a zeroed clock starts it at 0.
+ *
+ * @param clock Frame clock
+ * @param fps Target frames per second (0 is treated as 1)
+ * @param now_us Current time in microseconds
+ */
+void frame_clock_start(frame_clock_t *clock, uint32_t fps, uint64_t now_us);
+
+/**
+ * @brief Finish the current frame and schedule the next one
+ *
+ * When rendering overran one or more frame slots the missed slots are
+ * counted as dropped and the deadline jumps forward on the same grid.
+ *
+ * @param clock Frame clock
+ * @param now_us Current time in microseconds
+ * @return Microseconds to wait before the next frame starts
+ */
+uint64_t frame_clock_next(frame_clock_t *clock, uint64_t now_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FRAME_CLOCK_H
@@ -0,0 +1,82 @@
+/*
+ * Frame Metrics Implementation
+ */
+
+#include "frame_metrics.h"
+#include <string.h>
+
+// Values below 8 get a bucket each, every octave above is split in four
+static uint32_t bucket_of(uint32_t us) {
+  if (us < 8) {
+    return us;
+  }
+  uint32_t octave = 31 - __builtin_clz(us); // 3 or more
+  uint32_t bucket = 8 + (octave - 3) * 4 + ((us >> (octave - 2)) & 3);
+  return bucket < FRAME_METRICS_BUCKETS ? bucket : FRAME_METRICS_BUCKETS - 1;
+}
+
+// Largest value that falls into a bucket
+static uint32_t bucket_limit(uint32_t bucket) {
+  if (bucket < 8) {
+    return bucket;
+  }
+  uint32_t octave = (bucket - 8) / 4 + 3;
+  uint32_t lower = (4 + (bucket - 8) % 4) << (octave - 2);
+  return lower + (1u << (octave - 2)) - 1;
+}
+
+void frame_metrics_reset(frame_metrics_t *metrics, uint64_t now_us) {
+  memset(metrics, 0, sizeof(*metrics));
+  metrics->start_us = now_us;
+}
+
+void frame_histogram_add(frame_histogram_t *histogram, uint32_t us) {
+  if (histogram->count == 0 || us < histogram->min_us) {
+    histogram->min_us = us;
+  }
+  if (us > histogram->max_us) {
+    histogram->max_us = us;
+  }
+  histogram->count++;
+  histogram->total_us += us;
+  histogram->buckets[bucket_of(us)]++;
+}
+
+uint32_t frame_histogram_percentile(const frame_histogram_t *histogram,
+                                    uint32_t permille) {
+  if (histogram->count == 0) {
+    return 0;
+  }
+  // Rank of the sample, rounded up so p100 is the largest one
+  uint64_t rank = ((uint64_t)histogram->count * permille + 999) / 1000;
+  if (rank == 0) {
+    rank = 1;
+  }
+
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < FRAME_METRICS_BUCKETS; i++) {
+    seen += histogram->buckets[i];
+    if (seen >= rank) {
+      // The bucket limit may lie above every sample in it, the last
+      // bucket has no limit at all
+      if (i == FRAME_METRICS_BUCKETS - 1) {
+        return histogram->max_us;
+      }
+      uint32_t limit = bucket_limit(i);
+      return limit < histogram->max_us ? limit : histogram->max_us;
+    }
+  }
+  return histogram->max_us;
+}
+
+uint32_t frame_histogram_average(const frame_histogram_t *histogram) {
+  return histogram->count ? (uint32_t)(histogram->total_us / histogram->count)
+                          : 0;
+}
+
+uint32_t frame_metrics_fps_x100(const frame_metrics_t *metrics,
+                                uint64_t now_us) {
+  uint64_t elapsed_us = now_us - metrics->start_us;
+  return elapsed_us ? (uint32_t)(metrics->frames * 100000000ULL / elapsed_us)
+                    : 0;
+}
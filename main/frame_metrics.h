@@ -0,0 +1,80 @@
+/*
+ * Frame Metrics
+ *
+ * Timing statistics of the render loop: duration histograms with min, max,
+ * average and percentiles, plus the achieved frame rate. Histogram buckets
+ * are log-linear (4 per power of two), so percentiles are within 25% of
+ * the true value from 1 us up to seconds in a few hundred bytes. Pure
+ * logic, time is passed in by the caller.
+ */
+
+#ifndef FRAME_METRICS_H
+#define FRAME_METRICS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FRAME_METRICS_BUCKETS 84 // Up to 2^22 us, longer samples share the last
+
+typedef struct {
+  uint32_t count;
+  uint32_t min_us;
+  uint32_t max_us;
+  uint64_t total_us;
+  uint32_t buckets[FRAME_METRICS_BUCKETS];
+} frame_histogram_t;
+
+typedef struct {
+  frame_histogram_t render;   // Effect, output stage and pack
+  frame_histogram_t transmit; // Handing the frame to the transport
+  uint64_t start_us;          // Start of the measurement window
+  uint32_t frames;            // Frames rendered in the window
+} frame_metrics_t;
+
+/**
+ * @brief Clear all statistics and start a new window
+ * @param metrics Metrics
+ * @param now_us Current time in microseconds
+ */
+void frame_metrics_reset(frame_metrics_t *metrics, uint64_t now_us);
+
+/**
+ * @brief Add a sample to a histogram
+ * @param histogram Histogram
+ * @param us Duration in microseconds
+ */
+void frame_histogram_add(frame_histogram_t *histogram, uint32_t us);
+
+/**
+ * @brief Value below which the given share of samples falls
+ * @param histogram Histogram
+ * @param permille Share in 1/1000, e.g. 990 for p99
+ * @return Upper bound of the bucket holding the percentile, 0 if empty
+ */
+uint32_t frame_histogram_percentile(const frame_histogram_t *histogram,
+                                    uint32_t permille);
+
+/**
+ * @brief Average duration
+ * @param histogram Histogram
+ * @return Average in microseconds, 0 if empty
+ */
+uint32_t frame_histogram_average(const frame_histogram_t *histogram);
+
+/**
+ * @brief Frames per second achieved since the last reset
+ * @param metrics Metrics
+ * @param now_us Current time in microseconds
+ * @return Frame rate in 1/100 frames per second
+ */
+uint32_t frame_metrics_fps_x100(const frame_metrics_t *metrics,
+                                uint64_t now_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FRAME_METRICS_H
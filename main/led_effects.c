@@ -5,644 +5,617 @@
 #include "led_effects.h"
 #include "esp_log.h"
 #include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/queue.h"
 #include "freertos/task.h"
-#include <math.h>
+#include <stdlib.h>
 #include <string.h>
 
 static const char *TAG = "led_effects";
 
-#if LED_SHOULD_ROUND == 1
-// Function to check if LED should be disabled for circular rounding
-static bool is_corner_led(int led_index, float threshold) {
-  // Calculate row and column position in the matrix
-  int row = led_index / LED_NUMBERS_COL;
-  int col = led_index % LED_NUMBERS_COL;
-
-  // Calculate distance from center for each LED
-  float center_x = (LED_NUMBERS_COL - 1) / 2.0f;
-  float center_y = (LED_NUMBERS_ROW - 1) / 2.0f;
-
-  float distance = sqrtf(powf(col - center_x, 2) + powf(row - center_y, 2));
-  float max_radius = sqrtf(powf(center_x, 2) + powf(center_y, 2));
-
-  // Disable LEDs that are outside the circular area
-  // Adjust the 0.9 factor to control how "round" the corners are
-  return distance > max_radius * threshold;
-}
-#endif
-
-// Utility function to clear LED matrix
-static void clear_led_matrix(led_effect_params_t *params) {
-  // Clear all pixels to black
-  for (int i = 0; i < LED_NUMBERS; i++) {
-    params->led_strip_pixels[i * 3 + 0] = 0; // Green
-    params->led_strip_pixels[i * 3 + 1] = 0; // Red
-    params->led_strip_pixels[i * 3 + 2] = 0; // Blue
+// An unchanged frame is still sent this often, so a LED that latched a
+// corrupted bit does not keep the wrong color
+#define LED_REFRESH_INTERVAL_US 1000000
+
+// Sends the freshly packed back buffer and swaps it to the front. The
+// transport waits for the previous frame only, so the next frame is
+// rendered while this one is on the wire.
+static esp_err_t present_frame(led_effect_params_t *params,
+                               size_t bytes_per_pixel) {
+  // The front buffer holds what the strip shows: a static scene is not
+  // sent again until the refresh interval runs out
+  size_t len = params->geometry.count * bytes_per_pixel;
+  int64_t now = esp_timer_get_time();
+  if (params->sent_bytes_per_pixel == bytes_per_pixel &&
+      now - params->sent_time_us < LED_REFRESH_INTERVAL_US &&
+      memcmp(params->back_pixels, params->front_pixels, len) == 0) {
+    params->skipped_frames++;
+    return ESP_OK;
   }
 
-  // Send cleared data to LED strip
-  esp_err_t ret = rmt_transmit(params->led_chan, params->led_encoder,
-                               params->led_strip_pixels,
-                               params->pixel_buffer_size, &params->tx_config);
-  if (ret != ESP_OK) {
-    ESP_LOGE(TAG, "RMT transmit failed in clear_led_matrix: %s", esp_err_to_name(ret));
-    return;
-  }
-  
-  ret = rmt_tx_wait_all_done(params->led_chan, pdMS_TO_TICKS(500));
+  led_transport_t *transport = params->transport;
+  esp_err_t ret = transport->transmit(transport, params->back_pixels,
+                                      params->geometry.count, bytes_per_pixel);
   if (ret != ESP_OK) {
-    ESP_LOGW(TAG, "RMT wait timeout in clear_led_matrix: %s", esp_err_to_name(ret));
+    ESP_LOGE(TAG, "Transmit failed: %s", esp_err_to_name(ret));
+    // Nothing to compare against, send the next frame in any case
+    params->sent_bytes_per_pixel = 0;
+  } else {
+    params->sent_bytes_per_pixel = bytes_per_pixel;
+    params->sent_time_us = now;
   }
-}
-
-static void led_strip_hsv2rgb(uint32_t h, uint32_t s, uint32_t v, uint32_t *r,
-                              uint32_t *g, uint32_t *b) {
-  h %= 360; // h -> [0,360]
-  uint32_t rgb_max = (v * 255) / 100;
-  uint32_t rgb_min = (rgb_max * (100 - s)) / 100;
-
-  uint32_t i = h / 60;
-  uint32_t diff = h % 60;
 
-  // RGB adjustment amount by hue
-  uint32_t rgb_adj = (rgb_max - rgb_min) * diff / 60;
-
-  switch (i) {
-  case 0:
-    *r = rgb_max;
-    *g = rgb_min + rgb_adj;
-    *b = rgb_min;
-    break;
-  case 1:
-    *r = rgb_max - rgb_adj;
-    *g = rgb_max;
-    *b = rgb_min;
-    break;
-  case 2:
-    *r = rgb_min;
-    *g = rgb_max;
-    *b = rgb_min + rgb_adj;
-    break;
-  case 3:
-    *r = rgb_min;
-    *g = rgb_max - rgb_adj;
-    *b = rgb_max;
-    break;
-  case 4:
-    *r = rgb_min + rgb_adj;
-    *g = rgb_min;
-    *b = rgb_max;
-    break;
-  default:
-    *r = rgb_max;
-    *g = rgb_min;
-    *b = rgb_max - rgb_adj;
-    break;
-  }
+  // Part of the frame may be in flight even after an error
+  uint8_t *sent = params->back_pixels;
+  params->back_pixels = params->front_pixels;
+  params->front_pixels = sent;
+  return ret;
 }
 
-void led_strip_firefly_task(void *pvParameters) {
-  led_effect_params_t *params = (led_effect_params_t *)pvParameters;
-  uint32_t red, green, blue;
-
-  // Цвета: черный фон, желтый светлячек
-  const uint16_t yellow_hue = 20;
-  const uint8_t saturation = 100;
-  const uint8_t firefly_max_brightness = 100;
-
-  // 2D position for firefly
-  float firefly_x = 0.0f;
-  float firefly_y = LED_NUMBERS_ROW / 2.0f;
-  float firefly_size = 3.0f;           // базовый размер светлячка в LED
-  const float firefly_size_min = 1.5f; // минимальный размер
-  const float firefly_size_max = 3.5f; // максимальный размер
-  float size_phase = 0.0f;
-  const float size_change_speed = 0.03f; // скорость изменения размера
-  float movement_phase = 0.0f;
-  const float movement_speed = 0.05f;
-  const float center_x = (LED_NUMBERS_COL - 1) / 2.0f;
-  const float center_y = (LED_NUMBERS_ROW - 1) / 2.0f;
-
-  const float figure8_width = LED_NUMBERS_COL * 0.8f;
-  const float figure8_height = LED_NUMBERS_ROW * 0.8f;
-  // Параметры для более естественного мерцания
-  float random_flicker_timer = 0.0f;
-  const float random_flicker_interval_min = 0.5f;
-  const float random_flicker_interval_max = 3.0f;
-  float next_random_flicker = random_flicker_interval_min;
-  bool is_random_dim = false;
-
-  // Эффект мерцания светлячка
-  float flicker_phase = 0.0f;
-  float flicker_speed = 0.2f;
-  // Параметры для вариации скорости мерцания
-  float flicker_variation = 0.0f;
-  float flicker_variation_phase = 0.0f;
-  const float flicker_variation_speed =
-      0.014f; // Медленнее чем основное мерцание
-  // Микро-мерцания
-  float micro_flicker = 0.0f;
-  float micro_flicker_phase = 0.0f;
-  const float micro_flicker_speed = 0.8f;   // Быстрые микро-мерцания
-  const float micro_flicker_amount = 0.15f; // Интенсивность микро-мерцаний
-
-  while (params->running) {
-    // Обновляем фазу движения
-    movement_phase += movement_speed;
-    if (movement_phase > 2 * M_PI) {
-      movement_phase -= 2 * M_PI;
-    }
-
-    // Обновляем фазу изменения размера
-    size_phase += size_change_speed;
-    if (size_phase > 2 * M_PI) {
-      size_phase -= 2 * M_PI;
-    }
-
-    firefly_size =
-        ((firefly_size_max - firefly_size_min) / 2) * (sin(size_phase) + 1.0f) +
-        firefly_size_min;
-
-    // Обновляем случайное мерцание
-    random_flicker_timer += 0.02f;
-    if (random_flicker_timer >= next_random_flicker) {
-      random_flicker_timer = 0.0f;
-      is_random_dim = !is_random_dim;
-
-      // Следующий интервал мерцания случайный
-      float random_factor = (float)esp_random() / UINT32_MAX;
-      next_random_flicker = random_flicker_interval_min +
-                            random_factor * (random_flicker_interval_max -
-                                             random_flicker_interval_min);
-    }
-
-    flicker_variation_phase += flicker_variation_speed;
-    if (flicker_variation_phase > 2 * M_PI) {
-      flicker_variation_phase -= 2 * M_PI;
-    }
-    flicker_variation =
-        (sin(flicker_variation_phase) + 1.0f) / 2.0f; // 0.0 - 1.0
-    flicker_speed = 0.1f + flicker_variation * 0.2f;  // 0.1 - 0.3
-
-    micro_flicker_phase += micro_flicker_speed;
-    if (micro_flicker_phase > 2 * M_PI) {
-      micro_flicker_phase -= 2 * M_PI;
-    }
-    micro_flicker = sin(micro_flicker_phase) * micro_flicker_amount;
-
-    // u0412u043eu0441u044cu043cu0435u0440u043au0430 -
-    // u0435u0434u0438u043du0441u0442u0432u0435u043du043du044bu0439
-    // u0440u0435u0436u0438u043c u0434u0432u0438u0436u0435u043du0438u044f
-    firefly_x = center_x + (figure8_width / 2) * sin(movement_phase);
-    firefly_y = center_y + (figure8_height / 2) * sin(movement_phase) *
-                               cos(movement_phase);
-
-    // Обновляем мерцание
-    flicker_phase += flicker_speed;
-    if (flicker_phase >= M_PI * 2) {
-      flicker_phase = 0;
-    }
-
-    // Яркость светлячка с мерцанием
-    float flicker = (sin(flicker_phase) + 1.0f) / 2.0f;
-
-    // Добавляем микро-мерцания для большей естественности
-    flicker += micro_flicker;
-    if (flicker < 0.3f)
-      flicker = 0.3f; // Минимальная яркость
-    if (flicker > 1.0f)
-      flicker = 1.0f; // Максимальная яркость
+// Utility function to clear LED matrix
+static void clear_led_matrix(led_effect_params_t *params) {
+  size_t bytes_per_pixel = led_pack_bytes_per_pixel(params->pixel_format);
+  memset(params->back_pixels, 0, params->geometry.count * bytes_per_pixel);
+  present_frame(params, bytes_per_pixel);
+}
 
-    if (is_random_dim) {
-      flicker *= 0.5f; // Dim by 50% during random flickering
+// Applies every pending command. The task is the only writer of the
+// control state, so a burst from several sources needs no locking and ends
+// up in a single frame.
+static void apply_commands(led_effect_params_t *params) {
+  led_command_t command;
+  while (xQueueReceive(params->commands, &command, 0) == pdTRUE) {
+    switch (command.kind) {
+    case LED_COMMAND_SET_EFFECT:
+      params->effect_index = command.value;
+      params->running = true;
+      break;
+    case LED_COMMAND_NEXT_EFFECT:
+      params->effect_index = (params->effect_index + 1) % params->effect_count;
+      params->running = true;
+      break;
+    case LED_COMMAND_SET_RUNNING:
+      params->running = command.value != 0;
+      break;
+    case LED_COMMAND_TOGGLE_RUNNING:
+      params->running = !params->running;
+      break;
+    case LED_COMMAND_SET_TRANSITION:
+      params->transition_ms = (uint16_t)command.value;
+      break;
+    default: // Brightness is never queued
+      break;
     }
+  }
 
-    uint8_t firefly_brightness = (uint8_t)(firefly_max_brightness * flicker);
+  portENTER_CRITICAL(&params->control_lock);
+  int16_t brightness = params->brightness_request;
+  params->brightness_request = -1;
+  portEXIT_CRITICAL(&params->control_lock);
+  if (brightness >= 0) {
+    params->brightness = (uint8_t)brightness;
+  }
 
-    for (int j = 0; j < LED_NUMBERS; j++) {
-#if LED_SHOULD_ROUND == 1
-      if (is_corner_led(j, 0.95f)) {
-        // Отключаем угловые светодиоды
-        params->led_strip_pixels[j * 3 + 0] = 0;
-        params->led_strip_pixels[j * 3 + 1] = 0;
-        params->led_strip_pixels[j * 3 + 2] = 0;
+  if (params->params_changed) {
+    // Cleared first: a request stored during the copy is taken next time
+    params->params_changed = false;
+    int count = params->effect_count * EFFECT_MAX_PARAMS;
+    int active = params->effect_index;
+    for (int i = 0; i < count; i++) {
+      int32_t value = params->param_requests[i];
+      if (params->param_values[i] == value) {
         continue;
       }
-#endif
-
-      // Определяем расстояние до светлячка
-      // Переводим 1D индекс в 2D координаты
-      int row = j / LED_NUMBERS_COL;
-      int col = j % LED_NUMBERS_COL;
-
-      // Рассчитываем расстояние в 2D
-      float distance =
-          sqrtf(powf(col - firefly_x, 2) + powf(row - firefly_y, 2));
-
-      if (distance <= firefly_size) {
-        // Светлячек - плавное затухание от центра
-        float intensity = 1.0f - (distance / firefly_size);
-        intensity = intensity * intensity; // квадратичное затухание
-
-        uint8_t brightness = (uint8_t)(firefly_brightness * intensity);
-        led_strip_hsv2rgb(yellow_hue, saturation, brightness, &red, &green,
-                          &blue);
-      } else {
-        // Фон - черный
-        red = 0;
-        green = 0;
-        blue = 0;
+      params->param_values[i] = value;
+      // A static scene has to be drawn again with the new value
+      if (i / EFFECT_MAX_PARAMS == active) {
+        params->repaint = true;
       }
-
-      // Применяем общую яркость
-      red = (red * params->brightness) / 255;
-      green = (green * params->brightness) / 255;
-      blue = (blue * params->brightness) / 255;
-
-      params->led_strip_pixels[j * 3 + 0] = green;
-      params->led_strip_pixels[j * 3 + 1] = red;
-      params->led_strip_pixels[j * 3 + 2] = blue;
     }
+  }
 
-    esp_err_t ret = rmt_transmit(
-        params->led_chan, params->led_encoder, params->led_strip_pixels,
-        params->pixel_buffer_size, &params->tx_config);
-    if (ret != ESP_OK) {
-      ESP_LOGE(TAG, "RMT transmit failed: %s", esp_err_to_name(ret));
-      vTaskDelay(pdMS_TO_TICKS(10));
-      continue;
+  if (params->map_request != LED_MAP_REQUEST_NONE) {
+    // A custom map is copied under the lock, so a newer one cannot be
+    // written into it halfway; a layout is only a few bytes
+    portENTER_CRITICAL(&params->control_lock);
+    led_map_request_t request = params->map_request;
+    led_layout_t layout = params->layout_request;
+    if (request == LED_MAP_REQUEST_CUSTOM) {
+      memcpy(params->pixel_map, params->pixel_map_request,
+             params->geometry.count * sizeof(uint16_t));
     }
-    
-    // Увеличиваем таймаут ожидания до 500ms
-    ret = rmt_tx_wait_all_done(params->led_chan, pdMS_TO_TICKS(500));
-    if (ret != ESP_OK) {
-      ESP_LOGW(TAG, "RMT wait timeout: %s, continuing anyway", esp_err_to_name(ret));
-      // Продолжаем выполнение даже при таймауте
+    params->map_request = LED_MAP_REQUEST_NONE;
+    portEXIT_CRITICAL(&params->control_lock);
+    if (request == LED_MAP_REQUEST_LAYOUT) {
+      led_pack_build_map(&layout, params->geometry.width,
+                         params->geometry.height, params->pixel_map);
     }
-
-    // Уменьшаем задержку для увеличения FPS
-    vTaskDelay(pdMS_TO_TICKS(45));
+    params->repaint = true;
   }
+}
 
-  // Clear LED matrix before task termination
-  clear_led_matrix(params);
-
-  params->last_task_handle = params->task_handle;
-  params->task_handle = NULL;
-  vTaskDelete(NULL);
+// Something for apply_commands(), checked before the task goes to sleep
+static bool commands_pending(led_effect_params_t *params) {
+  return uxQueueMessagesWaiting(params->commands) > 0 ||
+         params->brightness_request >= 0 || params->params_changed;
 }
 
-void led_strip_fire_task(void *pvParameters) {
+// Единственная задача отрисовки: эффект меняется между кадрами
+static void render_task(void *pvParameters) {
   led_effect_params_t *params = (led_effect_params_t *)pvParameters;
-
-  // Heat array for fire simulation (2D matrix)
-  static uint8_t heat[LED_NUMBERS_ROW][LED_NUMBERS_COL];
-  uint32_t red, green, blue;
-
-  // Initialize heat array
-  for (int row = 0; row < LED_NUMBERS_ROW; row++) {
-    for (int col = 0; col < LED_NUMBERS_COL; col++) {
-      heat[row][col] = 0;
-    }
-  }
-
-  float_t threshold = 0.1f; // Начальное значение
-  const float_t target_threshold = 0.8f;
-  const float_t threshold_step = (target_threshold - threshold) / (10 / 5);
-  while (params->running) {
-
-    if (threshold < target_threshold) {
-      threshold += threshold_step;
-      if (threshold > target_threshold) {
-        threshold = target_threshold;
+  const led_effect_info_t *active = NULL;
+  bool cleared = false;
+  bool repaint = true; // The strip does not show the frame the effect has
+  bool dithering = false; // Apply the next frame even if it is unchanged
+  uint32_t t = 0;
+  int slot = 0; // effect_state of the active effect, the other one fades
+  const led_effect_info_t *fading = NULL;
+  const int32_t *fading_params = NULL;
+  uint32_t fading_t = 0;
+  int64_t fade_start_us = 0;
+  int64_t fade_us = 0;
+
+  while (true) {
+    apply_commands(params);
+    const led_effect_info_t *effect =
+        params->effect_index >= 0 ? &params->effects[params->effect_index]
+                                  : NULL;
+
+    if (effect != active) {
+      // The shown effect fades out from its own state. A switch during a
+      // fade drops the older effect, the one fading in becomes the old one.
+      fading = NULL;
+      if (effect && active && params->running && !cleared &&
+          params->transition_ms) {
+        fading = active;
+        fading_params = &params->param_values[(active - params->effects) *
+                                              EFFECT_MAX_PARAMS];
+        fading_t = t;
+        fade_start_us = esp_timer_get_time();
+        fade_us = params->transition_ms * 1000LL;
+        slot ^= 1;
       }
-    }
-    // Step 1: Cool down every cell
-    for (int row = 0; row < LED_NUMBERS_ROW; row++) {
-      for (int col = 0; col < LED_NUMBERS_COL; col++) {
-        uint8_t cooling = (esp_random() % 10) + 5; // 5-14
-        if (cooling > heat[row][col]) {
-          heat[row][col] = 0;
-        } else {
-          heat[row][col] -= cooling;
-        }
+      if (effect && effect->init) {
+        effect->init(params->effect_state[slot], &params->geometry);
       }
-    }
-
-    // Step 2: Heat propagation (более простое и надежное)
-    for (int row = LED_NUMBERS_ROW - 1; row > 0; row--) {
-      for (int col = 0; col < LED_NUMBERS_COL; col++) {
-        // Простое распространение: 80% от нижнего + 20% от текущего
-        if (row > 0) {
-          heat[row][col] = (heat[row - 1][col] * 8 + heat[row][col] * 2) / 10;
-        }
+      active = effect;
+      repaint = true;
+      t = 0;
+      if (active) {
+        frame_clock_start(&params->clock, active->fps, esp_timer_get_time());
       }
     }
 
-    // Step 3: Add new sparks at the bottom row
-    for (int col = 0; col < LED_NUMBERS_COL; col++) {
-      if (esp_random() % 10 < 5) {                 // 50% chance per bottom cell
-        uint8_t spark = 180 + (esp_random() % 76); // 180-255
-        if (spark > heat[0][col]) {
-          heat[0][col] = spark;
-        }
-      }
+    // Also taken while dark, a reset asked for then must not stay pending
+    // and wipe the frames of a later window
+    if (params->metrics_reset) {
+      params->metrics_reset = false;
+      frame_metrics_reset(&params->metrics, esp_timer_get_time());
     }
 
-    // Step 4: ЧИСТАЯ ОГНЕННАЯ ПАЛИТРА БЕЗ СИНЕГО
-    for (int i = 0; i < LED_NUMBERS; i++) {
-      int row = i / LED_NUMBERS_COL;
-      int col = i % LED_NUMBERS_COL;
-
-#if LED_SHOULD_ROUND == 1
-      if (is_corner_led(i, threshold)) {
-        // Disable corner LEDs
-        params->led_strip_pixels[i * 3 + 0] = 0;
-        params->led_strip_pixels[i * 3 + 1] = 0;
-        params->led_strip_pixels[i * 3 + 2] = 0;
-        continue;
+    if (!params->running || !active) {
+      fading = NULL;
+      if (!cleared) {
+        clear_led_matrix(params);
+        cleared = true;
       }
-#endif
-
-      // Чистая огненная палитра: черный → красный → оранжевый
-      uint8_t heat_val = heat[row][col];
-
-      if (heat_val < 85) {    // Черный → темно-красный
-        red = heat_val * 3;   // 0-255
-        green = heat_val / 4; // 0-21 (очень мало зеленого)
-        blue = 0;
-      } else if (heat_val < 170) { // Темно-красный → ярко-красный
-        red = 255;
-        green = (heat_val - 85) * 1; // 0-170 (умеренный зеленый)
-        blue = 0;
-      } else { // Красный → оранжевый → желтый
-        red = 255;
-        green = 140 + (heat_val - 170) / 2; // 170-255
-        blue = 0;
+      // Sleep until a command arrives. Senders wake an idle task for every
+      // command, so commands are applied while dark and never pile up.
+      params->idle = true;
+      if (!commands_pending(params)) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
       }
+      params->idle = false;
+      continue;
+    }
+    if (cleared) {
+      // Resuming after a pause, the old deadlines are meaningless
+      frame_clock_start(&params->clock, active->fps, esp_timer_get_time());
+      cleared = false;
+      repaint = true;
+    }
 
-      // Применяем общую яркость
-      red = (red * params->brightness) / 255;
-      green = (green * params->brightness) / 255;
-      blue = (blue * params->brightness) / 255;
-
-      // Правильный порядок GRB
-      params->led_strip_pixels[i * 3 + 0] = green;
-      params->led_strip_pixels[i * 3 + 1] = red;
-      params->led_strip_pixels[i * 3 + 2] = blue;
+    int64_t render_start = esp_timer_get_time();
+    render_frame_t frame = {
+        .pixels = params->render_pixels,
+        .geometry = &params->geometry,
+        .changed = false,
+        .params = &params->param_values[(active - params->effects) *
+                                        EFFECT_MAX_PARAMS]};
+    active->render(params->effect_state[slot], t++, &frame);
+
+    if (fading) {
+      int64_t elapsed_us = esp_timer_get_time() - fade_start_us;
+      if (elapsed_us < fade_us) {
+        render_frame_t old = {.pixels = params->fade_pixels,
+                              .geometry = &params->geometry,
+                              .params = fading_params};
+        fading->render(params->effect_state[slot ^ 1], fading_t++, &old);
+        led_output_blend(params->render_pixels, params->fade_pixels,
+                         params->geometry.count * 3,
+                         (uint16_t)(elapsed_us * 256 / fade_us));
+        frame.changed = true;
+      } else {
+        // The last blended frame still has some of the old effect
+        fading = NULL;
+        repaint = true;
+      }
     }
 
-    // Send to LEDs
-    esp_err_t ret = rmt_transmit(
-        params->led_chan, params->led_encoder, params->led_strip_pixels,
-        params->pixel_buffer_size, &params->tx_config);
-    if (ret != ESP_OK) {
-      ESP_LOGE(TAG, "RMT transmit failed: %s", esp_err_to_name(ret));
-      vTaskDelay(pdMS_TO_TICKS(10));
-      continue;
+    // Settings from the web server change the output of an unchanged frame
+    if (params->repaint || params->brightness != params->output.brightness) {
+      params->repaint = false;
+      repaint = true;
     }
-    
-    ret = rmt_tx_wait_all_done(params->led_chan, pdMS_TO_TICKS(500));
-    if (ret != ESP_OK) {
-      ESP_LOGW(TAG, "RMT wait timeout: %s, continuing anyway", esp_err_to_name(ret));
+    bool refresh_due = esp_timer_get_time() - params->sent_time_us >=
+                       LED_REFRESH_INTERVAL_US;
+
+    // An unchanged frame still goes out for a while when dithering moves
+    // its dim channels, they would otherwise step only once a refresh
+    if (frame.changed || repaint || refresh_due || dithering) {
+      // Rebuilds the lookup table only when the brightness has changed
+      led_output_set_brightness(&params->output, params->brightness);
+      dithering = led_output_dithers(&params->output, frame.changed || repaint,
+                                     params->render_pixels,
+                                     params->geometry.count * 3);
+      led_output_apply(&params->output, params->render_pixels,
+                       params->geometry.count * 3);
+
+      // The format may change from the web server, pack and send with one
+      led_pixel_format_t format = params->pixel_format;
+      led_pack(format, params->render_pixels, params->back_pixels,
+               params->geometry.count, params->pixel_map);
+      int64_t transmit_start = esp_timer_get_time();
+      frame_histogram_add(&params->metrics.render,
+                          (uint32_t)(transmit_start - render_start));
+      // Includes waiting for the previous frame to leave the transport
+      esp_err_t ret = present_frame(params, led_pack_bytes_per_pixel(format));
+      frame_histogram_add(&params->metrics.transmit,
+                          (uint32_t)(esp_timer_get_time() - transmit_start));
+      if (ret != ESP_OK) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+        continue;
+      }
+      repaint = false;
+    } else {
+      // Static scene, dithering done: nothing to pack or send, the task
+      // sleeps until the next frame
+      frame_histogram_add(&params->metrics.render,
+                          (uint32_t)(esp_timer_get_time() - render_start));
+      params->skipped_frames++;
     }
+    params->metrics.frames++;
 
-    vTaskDelay(pdMS_TO_TICKS(40));
+    // Round up to whole ticks so a frame never starts before its deadline.
+    // A notification cuts the wait short so switching takes effect at once.
+    uint64_t wait_us = frame_clock_next(&params->clock, esp_timer_get_time());
+    const uint64_t tick_us = 1000000ULL / configTICK_RATE_HZ;
+    ulTaskNotifyTake(pdTRUE, (TickType_t)((wait_us + tick_us - 1) / tick_us));
   }
-
-  // Clear LED matrix before task termination
-  clear_led_matrix(params);
-
-  params->last_task_handle = params->task_handle;
-  params->task_handle = NULL;
-  vTaskDelete(NULL);
 }
 
-void led_strip_stars_task(void *pvParameters) {
-  led_effect_params_t *params = (led_effect_params_t *)pvParameters;
-  uint32_t red, green, blue;
-
-  // Star structure
-  typedef struct {
-    int position;            // LED index
-    float brightness;        // Current brightness (0.0 - 1.0)
-    float target_brightness; // Target brightness
-    float fade_speed;        // How fast it fades
-    bool active;             // Is this star active
-    uint8_t color_type;      // 0=cool white, 1=warm white, 2=blue-white
-    float timer;             // For timing control
-    float next_change;       // When to change state
-  } star_t;
-
-  // Array of stars
-  const int MAX_STARS = LED_NUMBERS / 4; // Up to 25% of LEDs can be stars
-  static star_t stars[LED_NUMBERS / 4];
-
-  // Initialize stars
-  for (int i = 0; i < MAX_STARS; i++) {
-    stars[i].position = esp_random() % LED_NUMBERS;
-    stars[i].brightness = 0.0f;
-    stars[i].target_brightness = 0.0f;
-    stars[i].fade_speed =
-        0.01f + (float)(esp_random() % 30) / 1000.0f; // 0.01-0.04
-    stars[i].active = false;
-    stars[i].color_type = esp_random() % 3;
-    stars[i].timer = 0.0f;
-    stars[i].next_change =
-        (float)(esp_random() % 3000) / 1000.0f; // 0-3 seconds
-  }
-
-  float_t threshold = 0.1f;
-  const float_t target_threshold = 0.95f;
-  const float_t threshold_step = (target_threshold - threshold) / (100 / 5);
-
-  while (params->running) {
-    // Gradually increase corner rounding threshold
-    if (threshold < target_threshold) {
-      threshold += threshold_step;
-      if (threshold > target_threshold) {
-        threshold = target_threshold;
-      }
-    }
+// Hands out consecutive, aligned pieces of the arena. Called with a NULL
+// base it only sums up the sizes.
+static void *arena_take(uint8_t *base, size_t *offset, size_t size) {
+  const size_t align = 8;
+  void *piece = base ? base + *offset : NULL;
+  *offset += (size + align - 1) & ~(align - 1);
+  return piece;
+}
 
-    // Update stars
-    for (int i = 0; i < MAX_STARS; i++) {
-      stars[i].timer += 0.05f;
-
-      // Check if it's time to change star state
-      if (stars[i].timer >= stars[i].next_change) {
-        stars[i].timer = 0.0f;
-
-        if (stars[i].active && stars[i].target_brightness > 0.1f) {
-          // Start fading out
-          stars[i].target_brightness = 0.0f;
-          stars[i].next_change =
-              1.0f + (float)(esp_random() % 2000) / 1000.0f; // 1-3s
-        } else if (!stars[i].active || stars[i].target_brightness <= 0.1f) {
-          // Randomly activate star or keep it inactive
-          if (esp_random() % 100 < 15) { // 15% chance to activate
-            stars[i].active = true;
-            stars[i].position = esp_random() % LED_NUMBERS;
-            stars[i].target_brightness =
-                0.3f + (float)(esp_random() % 70) / 100.0f; // 0.3-1.0
-            stars[i].color_type = esp_random() % 3;
-            stars[i].fade_speed =
-                0.008f + (float)(esp_random() % 25) / 1000.0f; // 0.008-0.033
-            stars[i].next_change =
-                2.0f + (float)(esp_random() % 4000) / 1000.0f; // 2-6s
-          } else {
-            stars[i].next_change =
-                0.5f + (float)(esp_random() % 1500) / 1000.0f; // 0.5-2s
-          }
-        }
-      }
+// Lays out every per-geometry buffer, returns the arena size
+static size_t layout_arena(led_effect_params_t *params, uint8_t *base,
+                           size_t max_state_size, void **tables,
+                           uint8_t **residual) {
+  const render_geometry_t *geometry = &params->geometry;
+  const size_t count = (size_t)geometry->width * geometry->height;
+  size_t offset = 0;
+
+  *tables = arena_take(base, &offset, render_tables_size(geometry));
+  params->render_pixels = arena_take(base, &offset, count * 3);
+  *residual = arena_take(base, &offset, count * 3);
+  params->pixel_buffer_size = count * LED_PACK_MAX_BYTES_PER_PIXEL;
+  params->front_pixels = arena_take(base, &offset, params->pixel_buffer_size);
+  params->back_pixels = arena_take(base, &offset, params->pixel_buffer_size);
+  params->pixel_map = arena_take(base, &offset, count * sizeof(uint16_t));
+  params->pixel_map_request =
+      arena_take(base, &offset, count * sizeof(uint16_t));
+  params->fade_pixels = arena_take(base, &offset, count * 3);
+  params->effect_state[0] = arena_take(base, &offset, max_state_size);
+  params->effect_state[1] = arena_take(base, &offset, max_state_size);
+  const size_t param_count = (size_t)params->effect_count * EFFECT_MAX_PARAMS;
+  params->param_values =
+      arena_take(base, &offset, param_count * sizeof(int32_t));
+  params->param_requests =
+      arena_take(base, &offset, param_count * sizeof(int32_t));
+  return offset;
+}
 
-      // Update brightness towards target
-      if (stars[i].brightness < stars[i].target_brightness) {
-        stars[i].brightness += stars[i].fade_speed;
-        if (stars[i].brightness > stars[i].target_brightness) {
-          stars[i].brightness = stars[i].target_brightness;
-        }
-      } else if (stars[i].brightness > stars[i].target_brightness) {
-        stars[i].brightness -= stars[i].fade_speed;
-        if (stars[i].brightness < stars[i].target_brightness) {
-          stars[i].brightness = stars[i].target_brightness;
-        }
-      }
+esp_err_t led_render_start(led_effect_params_t *params, size_t max_state_size) {
+  if (!params) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (params->task_handle) {
+    ESP_LOGW(TAG, "Render task already running");
+    return ESP_OK;
+  }
+  const render_geometry_t *geometry = &params->geometry;
+  if (geometry->width == 0 || geometry->height == 0 ||
+      (uint32_t)geometry->width * geometry->height > LED_MAX_COUNT) {
+    ESP_LOGE(TAG, "Invalid matrix geometry %ux%u", geometry->width,
+             geometry->height);
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (!params->transport) {
+    ESP_LOGE(TAG, "No transport to send frames");
+    return ESP_ERR_INVALID_STATE;
+  }
 
-      // Deactivate completely faded stars
-      if (stars[i].brightness <= 0.01f) {
-        stars[i].active = false;
-        stars[i].brightness = 0.0f;
+  // One allocation for the lifetime of the task, sized to the geometry
+  void *tables;
+  uint8_t *residual;
+  size_t arena_size =
+      layout_arena(params, NULL, max_state_size, &tables, &residual);
+  params->arena = malloc(arena_size);
+  if (!params->arena) {
+    ESP_LOGE(TAG, "Failed to allocate %u bytes of render buffers",
+             (unsigned)arena_size);
+    return ESP_ERR_NO_MEM;
+  }
+  memset(params->arena, 0, arena_size);
+  layout_arena(params, params->arena, max_state_size, &tables, &residual);
+  params->effect_state_size = max_state_size;
+  for (int i = 0; i < params->effect_count; i++) {
+    const led_effect_info_t *effect = &params->effects[i];
+    int32_t *values = &params->param_values[i * EFFECT_MAX_PARAMS];
+    effect_params_reset(effect, values);
+    for (int p = 0; params->stored_params && p < effect->param_count; p++) {
+      int32_t value = params->stored_params[i * EFFECT_MAX_PARAMS + p];
+      if (value >= effect->params[p].min && value <= effect->params[p].max) {
+        values[p] = value;
       }
     }
+  }
+  for (int i = 0; i < params->effect_count * EFFECT_MAX_PARAMS; i++) {
+    params->param_requests[i] = params->param_values[i];
+  }
+  params->params_changed = false;
+  portMUX_INITIALIZE(&params->control_lock);
+  params->brightness_request = -1;
+  params->idle = false;
+  // The strip shows whatever it had before, the first frame is always sent
+  params->sent_bytes_per_pixel = 0;
+  params->metrics_reset = false;
+  frame_metrics_reset(&params->metrics, esp_timer_get_time());
+
+  params->commands = xQueueCreate(LED_COMMAND_QUEUE_LENGTH,
+                                  sizeof(led_command_t));
+  if (!params->commands) {
+    ESP_LOGE(TAG, "Failed to create command queue");
+    free(params->arena);
+    params->arena = NULL;
+    return ESP_ERR_NO_MEM;
+  }
 
-    // Clear all LEDs to black background
-    for (int i = 0; i < LED_NUMBERS; i++) {
-      params->led_strip_pixels[i * 3 + 0] = 0; // Green
-      params->led_strip_pixels[i * 3 + 1] = 0; // Red
-      params->led_strip_pixels[i * 3 + 2] = 0; // Blue
+  render_init(&params->geometry, tables);
+  render_random_seed(esp_random());
+  led_output_init(&params->output, residual, params->geometry.count * 3);
+  // The task is not running yet, the map is written directly
+  params->map_request = LED_MAP_REQUEST_NONE;
+  if (!led_layout_valid(&params->layout)) {
+    ESP_LOGW(TAG, "Invalid layout, using progressive wiring");
+    params->layout = (led_layout_t){0};
+  }
+  led_pack_build_map(&params->layout, geometry->width, geometry->height,
+                     params->pixel_map);
+  if (params->custom_pixel_map) {
+    if (led_pack_map_valid(params->custom_pixel_map, geometry->count)) {
+      memcpy(params->pixel_map, params->custom_pixel_map,
+             geometry->count * sizeof(uint16_t));
+      ESP_LOGI(TAG, "Custom pixel map installed");
+    } else {
+      ESP_LOGW(TAG, "Ignoring invalid custom pixel map");
     }
+  }
 
-    // Render active stars
-    for (int i = 0; i < MAX_STARS; i++) {
-      if (!stars[i].active || stars[i].brightness <= 0.01f) {
-        continue;
-      }
-
-      int pos = stars[i].position;
+  BaseType_t result = xTaskCreate(render_task, "led_render", 4096, params, 5,
+                                  &params->task_handle);
+  if (result != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create render task");
+    vQueueDelete(params->commands);
+    params->commands = NULL;
+    free(params->arena);
+    params->arena = NULL;
+    params->effect_state[0] = params->effect_state[1] = NULL;
+    params->param_values = NULL;
+    params->param_requests = NULL;
+    return ESP_FAIL;
+  }
 
-#if LED_SHOULD_ROUND == 1
-      if (is_corner_led(pos, threshold)) {
-        continue; // Skip corner LEDs
-      }
-#endif
-
-      // Set star color based on type
-      uint8_t base_brightness = (uint8_t)(255 * stars[i].brightness);
-
-      switch (stars[i].color_type) {
-      case 0: // Cool white
-        red = base_brightness;
-        green = base_brightness;
-        blue = (uint8_t)(base_brightness * 1.2f);
-        if (blue > 255)
-          blue = 255;
-        break;
-      case 1: // Warm white
-        red = base_brightness;
-        green = (uint8_t)(base_brightness * 0.8f);
-        blue = (uint8_t)(base_brightness * 0.4f);
-        break;
-      case 2: // Blue-white
-        red = (uint8_t)(base_brightness * 0.8f);
-        green = (uint8_t)(base_brightness * 0.9f);
-        blue = base_brightness;
-        break;
-      default:
-        red = green = blue = base_brightness;
-        break;
-      }
+  ESP_LOGI(TAG, "Render task started, %ux%u LEDs, %u bytes of buffers",
+           geometry->width, geometry->height, (unsigned)arena_size);
+  return ESP_OK;
+}
 
-      // Apply global brightness
-      red = (red * params->brightness) / 255;
-      green = (green * params->brightness) / 255;
-      blue = (blue * params->brightness) / 255;
+void led_render_stop(led_effect_params_t *params) {
+  if (!params || !params->task_handle) {
+    return;
+  }
+  vTaskDelete(params->task_handle);
+  params->task_handle = NULL;
+  // Let the last frame finish before its buffer is released
+  params->transport->wait_done(params->transport, 500);
+  vQueueDelete(params->commands);
+  params->commands = NULL;
+  free(params->arena);
+  params->arena = NULL;
+  params->effect_state[0] = params->effect_state[1] = NULL;
+  params->param_values = NULL;
+  params->param_requests = NULL;
+  params->output.residual = NULL;
+  params->pixel_map = NULL;
+  params->pixel_map_request = NULL;
+}
 
-      // Set pixel (GRB format)
-      params->led_strip_pixels[pos * 3 + 0] = green;
-      params->led_strip_pixels[pos * 3 + 1] = red;
-      params->led_strip_pixels[pos * 3 + 2] = blue;
-    }
+static esp_err_t queue_command(led_effect_params_t *params,
+                               const led_command_t *command) {
+  // A full queue means the render task is stuck, waiting would not help
+  if (xQueueSend(params->commands, command, 0) != pdTRUE) {
+    ESP_LOGW(TAG, "Command queue full, command %d dropped", command->kind);
+    return ESP_ERR_TIMEOUT;
+  }
+  // Effect and power changes cut the frame wait short. The rest waits for
+  // the next frame, so a burst does not squeeze in extra frames; only a
+  // task sleeping with the matrix dark is woken for them.
+  bool wake = command->kind == LED_COMMAND_SET_EFFECT ||
+              command->kind == LED_COMMAND_NEXT_EFFECT ||
+              command->kind == LED_COMMAND_SET_RUNNING ||
+              command->kind == LED_COMMAND_TOGGLE_RUNNING || params->idle;
+  if (wake && params->task_handle) {
+    xTaskNotifyGive(params->task_handle);
+  }
+  return ESP_OK;
+}
 
-    // Transmit to LED strip
-    ESP_ERROR_CHECK(rmt_transmit(
-        params->led_chan, params->led_encoder, params->led_strip_pixels,
-        params->pixel_buffer_size, &params->tx_config));
-    ESP_ERROR_CHECK(rmt_tx_wait_all_done(params->led_chan, pdMS_TO_TICKS(100)));
+// Folds a brightness change into the single pending value
+static esp_err_t request_brightness(led_effect_params_t *params,
+                                    led_command_kind_t kind, int32_t value) {
+  portENTER_CRITICAL(&params->control_lock);
+  if (kind == LED_COMMAND_ADJUST_BRIGHTNESS) {
+    int32_t base = params->brightness_request >= 0
+                       ? params->brightness_request
+                       : params->brightness;
+    value = base + value;
+    value = value < 1 ? 1 : value > 255 ? 255 : value;
+  }
+  params->brightness_request = (int16_t)value;
+  portEXIT_CRITICAL(&params->control_lock);
+  if (params->idle && params->task_handle) {
+    xTaskNotifyGive(params->task_handle);
+  }
+  return ESP_OK;
+}
 
-    vTaskDelay(pdMS_TO_TICKS(50)); // 20 FPS for smooth twinkling
+esp_err_t led_render_send(led_effect_params_t *params, led_command_kind_t kind,
+                          int32_t value) {
+  if (!params || !params->commands) {
+    return ESP_ERR_INVALID_STATE;
   }
 
-  // Clear LED matrix before task termination
-  clear_led_matrix(params);
+  // Values are checked here, the render task applies them blindly
+  switch (kind) {
+  case LED_COMMAND_SET_EFFECT: {
+    if (value < 0 || value >= params->effect_count) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    const led_effect_info_t *effect = &params->effects[value];
+    if (effect->state_size &&
+        effect->state_size(&params->geometry) > params->effect_state_size) {
+      ESP_LOGE(TAG, "State of %s does not fit the render buffer",
+               effect->name);
+      return ESP_ERR_INVALID_ARG;
+    }
+    break;
+  }
+  case LED_COMMAND_NEXT_EFFECT:
+    if (params->effect_count == 0) {
+      return ESP_ERR_INVALID_STATE;
+    }
+    break;
+  case LED_COMMAND_SET_BRIGHTNESS:
+    if (value < 1 || value > 255) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    return request_brightness(params, kind, value);
+  case LED_COMMAND_ADJUST_BRIGHTNESS:
+    return request_brightness(params, kind, value);
+  case LED_COMMAND_SET_TRANSITION:
+    if (value < 0 || value > LED_TRANSITION_MS_MAX) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    break;
+  default:
+    break;
+  }
 
-  params->last_task_handle = params->task_handle;
-  params->task_handle = NULL;
-  vTaskDelete(NULL);
+  return queue_command(params, &(led_command_t){.kind = kind, .value = value});
 }
-void led_strip_soft_light_task(void *pvParameters) {
-  led_effect_params_t *params = (led_effect_params_t *)pvParameters;
-  uint32_t red, green, blue;
-
-  float_t threshold = 0.1f; // Начальное значение
-  const float_t target_threshold = 0.8f;
-  const float_t threshold_step = (target_threshold - threshold) / 5; // 5 steps
-  while (params->running) {
-    if (threshold < target_threshold) {
-      threshold += threshold_step;
-      if (threshold > target_threshold) {
-        threshold = target_threshold;
-      }
-    }
 
-    for (int i = 0; i < LED_NUMBERS; i++) {
-      // Теплый белый ~2300K
-      red = 255;
-      green = 115;
-      blue = 23;
-
-#if LED_SHOULD_ROUND == 1
-      if (is_corner_led(i, threshold)) {
-        // Disable corner LEDs
-        params->led_strip_pixels[i * 3 + 0] = 0;
-        params->led_strip_pixels[i * 3 + 1] = 0;
-        params->led_strip_pixels[i * 3 + 2] = 0;
-        continue;
-      }
-#endif
+esp_err_t led_render_set_param(led_effect_params_t *params, int effect_index,
+                               int param_index, int32_t value) {
+  if (!params || !params->commands) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (effect_index < 0 || effect_index >= params->effect_count) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  const led_effect_info_t *effect = &params->effects[effect_index];
+  if (param_index < 0 || param_index >= effect->param_count) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  const effect_param_info_t *param = &effect->params[param_index];
+  if (value < param->min || value > param->max) {
+    return ESP_ERR_INVALID_ARG;
+  }
 
-      if (params->brightness <= 1) {
-        red = green = blue = 0;
-      } else {
-        red = (red * params->brightness) / 255;
-        green = (green * params->brightness) / 255;
-        blue = (blue * params->brightness) / 255;
-      }
-      params->led_strip_pixels[i * 3 + 0] = green;
-      params->led_strip_pixels[i * 3 + 1] = red;
-      params->led_strip_pixels[i * 3 + 2] = blue;
-    }
-    ESP_ERROR_CHECK(rmt_transmit(
-        params->led_chan, params->led_encoder, params->led_strip_pixels,
-        params->pixel_buffer_size, &params->tx_config));
-    ESP_ERROR_CHECK(rmt_tx_wait_all_done(params->led_chan, pdMS_TO_TICKS(100)));
-    vTaskDelay(pdMS_TO_TICKS(25));
+  // Value first, then the flag: the task never takes a half-made request
+  params->param_requests[effect_index * EFFECT_MAX_PARAMS + param_index] =
+      value;
+  params->params_changed = true;
+  if (params->idle && params->task_handle) {
+    xTaskNotifyGive(params->task_handle);
+  }
+  return ESP_OK;
+}
+
+esp_err_t led_render_set_pixel_format(led_effect_params_t *params,
+                                      led_pixel_format_t format) {
+  if (format >= LED_PIXEL_FORMAT_COUNT ||
+      params->geometry.count * led_pack_bytes_per_pixel(format) >
+          params->pixel_buffer_size) {
+    return ESP_ERR_INVALID_ARG;
   }
+  params->pixel_format = format;
+  params->repaint = true;
+  ESP_LOGI(TAG, "Pixel format: %s", led_pack_format_name(format));
+  return ESP_OK;
+}
 
-  clear_led_matrix(params);
+esp_err_t led_render_set_layout(led_effect_params_t *params,
+                                const led_layout_t *layout) {
+  if (!params->pixel_map_request) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (!led_layout_valid(layout)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  portENTER_CRITICAL(&params->control_lock);
+  params->layout_request = *layout;
+  params->map_request = LED_MAP_REQUEST_LAYOUT;
+  portEXIT_CRITICAL(&params->control_lock);
+  params->layout = *layout;
+  ESP_LOGI(TAG, "Layout: %s, rotation %u%s%s",
+           layout->serpentine ? "serpentine" : "progressive", layout->rotation,
+           layout->flip_x ? ", flip x" : "", layout->flip_y ? ", flip y" : "");
+  return ESP_OK;
+}
 
-  params->last_task_handle = params->task_handle;
-  params->task_handle = NULL;
-  vTaskDelete(NULL);
+esp_err_t led_render_set_pixel_map(led_effect_params_t *params,
+                                   const uint16_t *map, size_t count) {
+  if (!params->pixel_map_request) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (count != params->geometry.count) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  if (!led_pack_map_valid(map, count)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  // The render task installs it before its next frame
+  portENTER_CRITICAL(&params->control_lock);
+  memcpy(params->pixel_map_request, map, count * sizeof(uint16_t));
+  params->map_request = LED_MAP_REQUEST_CUSTOM;
+  portEXIT_CRITICAL(&params->control_lock);
+  ESP_LOGI(TAG, "Custom pixel map installed");
+  return ESP_OK;
 }
@@ -1,45 +1,257 @@
 /*
  * LED Strip Effects Module
  *
- * This module contains various LED strip effects for ESP32
+ * A single persistent FreeRTOS task renders the active effect from
+ * effect_render.h and sends every frame through a transport (RMT or SPI,
+ * see led_transport.h). Effects draw an RGB frame that is packed into the
+ * wire format of the strip. Wire frames are double buffered: the next one
+ * is rendered while the transport drains the previous. An effect switch
+ * cross-fades: for transition_ms both effects are rendered from their own
+ * state and their frames are blended.
  */
 
 #ifndef LED_EFFECTS_H
 #define LED_EFFECTS_H
 
-#include "driver/rmt_tx.h"
+#include "effect_render.h"
+#include "frame_clock.h"
+#include "frame_metrics.h"
+#include "led_output.h"
+#include "led_pack.h"
+#include "led_transport.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
 #include "freertos/task.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-// Configuration constants
-#define LED_NUMBERS_COL 8
-#define LED_NUMBERS_ROW 8
-#define LED_NUMBERS (LED_NUMBERS_COL * LED_NUMBERS_ROW)
-#define LED_SHOULD_ROUND 1 // Will round active leds to pretend a circle
-
 #define EXAMPLE_CHASE_SPEED_MS 10
 
+// Cross-fade between effects on a switch
+#define LED_TRANSITION_MS_DEFAULT 800
+#define LED_TRANSITION_MS_MAX 5000
+
+#define LED_COMMAND_QUEUE_LENGTH 16
+
+// Control commands. Buttons, the encoder and the web server only send
+// them, the render task applies all pending commands before its next frame.
+// Brightness is not queued: it lands in a single pending value, so a run of
+// encoder detents cannot fill the queue.
+typedef enum {
+  LED_COMMAND_SET_EFFECT,        // value: index into effects
+  LED_COMMAND_NEXT_EFFECT,       // value unused
+  LED_COMMAND_SET_RUNNING,       // value: 0 dark, 1 render
+  LED_COMMAND_TOGGLE_RUNNING,    // value unused
+  LED_COMMAND_SET_BRIGHTNESS,    // value: 1-255
+  LED_COMMAND_ADJUST_BRIGHTNESS, // value: signed step, clamped to 1-255
+  LED_COMMAND_SET_TRANSITION,    // value: 0 - LED_TRANSITION_MS_MAX
+} led_command_kind_t;
+
+typedef struct {
+  led_command_kind_t kind;
+  int32_t value;
+} led_command_t;
+
+// Strip settings kept in NVS
+#define LED_CONFIG_NVS_NAMESPACE "led_config"
+#define LED_CONFIG_NVS_PIXEL_FORMAT "pixel_format" // u8, led_pixel_format_t
+#define LED_CONFIG_NVS_WIDTH "width"                // u16, LEDs per row
+#define LED_CONFIG_NVS_HEIGHT "height"              // u16, rows
+#define LED_CONFIG_NVS_LAYOUT "layout"              // u8, see led_layout_encode
+#define LED_CONFIG_NVS_PIXEL_MAP "pixel_map"        // blob, u16 per LED
+#define LED_CONFIG_NVS_CHANNELS "channels"          // u8, RMT channels
+#define LED_CONFIG_NVS_TRANSPORT "transport"        // u8, led_transport_kind_t
+#define LED_CONFIG_NVS_CHIP "chip"                  // u8, led_chip_t
+#define LED_CONFIG_NVS_MIN_RESET "min_reset"        // u8, 1 = minimal reset
+#define LED_CONFIG_NVS_CONTROL "control" // u64, see control_state_pack
+// Parameter values of an effect: blob, i32 per parameter, key "p_" + id
+#define LED_CONFIG_NVS_PARAMS_PREFIX "p_"
+
+// Pixel map change waiting for the render task
+typedef enum {
+  LED_MAP_REQUEST_NONE,
+  LED_MAP_REQUEST_LAYOUT, // Build the map from layout_request
+  LED_MAP_REQUEST_CUSTOM, // Copy pixel_map_request
+} led_map_request_t;
+
+// Layout in one byte: bit 0 serpentine, bits 1-2 rotation in quarter
+// turns, bit 3 flip_x, bit 4 flip_y
+static inline uint8_t led_layout_encode(const led_layout_t *layout) {
+  return (layout->serpentine ? 1 : 0) | ((layout->rotation / 90) & 3) << 1 |
+         (layout->flip_x ? 1 << 3 : 0) | (layout->flip_y ? 1 << 4 : 0);
+}
+
+static inline led_layout_t led_layout_decode(uint8_t value) {
+  return (led_layout_t){.serpentine = value & 1,
+                        .rotation = ((value >> 1) & 3) * 90,
+                        .flip_x = (value >> 3) & 1,
+                        .flip_y = (value >> 4) & 1};
+}
+
 // Effect parameters structure
 typedef struct {
-  rmt_channel_handle_t led_chan;
-  rmt_encoder_handle_t led_encoder;
-  rmt_transmit_config_t tx_config;
-  bool running;
-  TaskHandle_t task_handle;
-  TaskHandle_t last_task_handle;
-  uint8_t *led_strip_pixels; // Pointer to LED pixel buffer
-  size_t pixel_buffer_size;  // Size of pixel buffer
-  uint8_t brightness;        // Brightness level (1-255)
+  led_transport_t *transport; // Sends wire frames, created before start
+  led_transport_kind_t transport_kind; // Backend the transport was made with
+  uint8_t channel_count;      // RMT channels the strip is split over
+  led_chip_t chip;            // Timing profile of the LEDs
+  bool min_reset;             // Shortest reset between frames
+  TaskHandle_t task_handle; // Render task
+  QueueHandle_t commands;   // led_command_t for the render task
+  const led_effect_info_t *effects; // Effects commands select from
+  int effect_count;
+  // Control state: set before start, then written by the render task only
+  volatile bool running;     // Render frames (true) or keep the matrix dark
+  volatile int effect_index; // Effect to render, -1 for none
+  volatile uint8_t brightness; // Brightness level (1-255)
+  volatile uint16_t transition_ms; // Cross-fade on a switch, 0 = cut
+  int32_t *param_values; // EFFECT_MAX_PARAMS per effect, written by the task
+  const int32_t *stored_params; // Same layout, replaces the defaults at start
+  // Pending settings, the latest value wins until the task takes it
+  portMUX_TYPE control_lock;   // Guards brightness_request and map requests
+  volatile int16_t brightness_request; // Brightness to apply, -1 for none
+  volatile int32_t *param_requests; // Same layout as param_values
+  volatile bool params_changed; // param_requests has values to apply
+  volatile bool idle;          // Task sleeps with the matrix dark
+  void *effect_state[2];     // States of the active and the fading effect
+  size_t effect_state_size;  // Size of each effect_state buffer
+  frame_clock_t clock;       // Paces frames of the active effect
+  render_geometry_t geometry; // Width and height are set before start
+  void *arena;               // Single allocation holding all buffers below
+  uint8_t *render_pixels;    // RGB frame the effects draw into
+  uint8_t *fade_pixels;      // RGB frame of the effect fading out
+  uint8_t *front_pixels;     // Wire frame last sent, owned by the transport
+  uint8_t *back_pixels;      // Wire frame packed next
+  size_t pixel_buffer_size;  // Size of each wire buffer
+  size_t sent_bytes_per_pixel; // Format of the front buffer, 0 if not sent
+  int64_t sent_time_us;      // When the front buffer was last sent
+  uint32_t skipped_frames;   // Frames equal to the shown one, not sent
+  volatile bool repaint;     // Settings changed, send the next frame
+  frame_metrics_t metrics;   // Render and transmit timing, owned by task
+  volatile bool metrics_reset; // Start a new metrics window
+  volatile led_pixel_format_t pixel_format; // Wire format of the strip
+  led_layout_t layout;       // Panel wiring the map is built from at start
+  const uint16_t *custom_pixel_map; // Replaces the layout at start, or NULL
+  uint16_t *pixel_map;       // Strip position of every LED, used when packing
+  volatile led_map_request_t map_request; // Map change for the task
+  led_layout_t layout_request;            // LED_MAP_REQUEST_LAYOUT
+  uint16_t *pixel_map_request;            // LED_MAP_REQUEST_CUSTOM
+  led_output_t output;       // Gamma, brightness, dithering; owned by task
 } led_effect_params_t;
 
-void led_strip_firefly_task(void *pvParameters);
-void led_strip_fire_task(void *pvParameters);
-void led_strip_soft_light_task(void *pvParameters);
-void led_strip_stars_task(void *pvParameters);
+/**
+ * @brief Start the render task
+ *
+ * Every buffer the task needs (frames, lookup tables, dithering and effect
+ * state) is sized from params->geometry and carved out of one allocation.
+ * Frames are sent through params->transport. The pixel map is built from
+ * params->layout, or copied from params->custom_pixel_map if that is a
+ * valid map. Parameter values start at params->stored_params where they
+ * are in range, else at the defaults. The caller keeps ownership of both.
+ *
+ * @param params LED effect parameters, must outlive the task
+ * @param max_state_size Largest state_size of all effects that will be set
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for a bad geometry,
+ *         ESP_ERR_INVALID_STATE without a transport
+ */
+esp_err_t led_render_start(led_effect_params_t *params, size_t max_state_size);
+
+/**
+ * @brief Stop the render task and release its buffers
+ * @param params LED effect parameters
+ */
+void led_render_stop(led_effect_params_t *params);
+
+/**
+ * @brief Send a control command to the render task
+ *
+ * Never blocks. Commands are applied in order before the next frame, so a
+ * burst (a spun encoder, several requests) costs one frame. Brightness
+ * changes are folded into one pending value, a relative step counts from
+ * the pending value if there is one. Selecting an
+ * effect also enables rendering; a disabled matrix is cleared once. On an
+ * effect switch both effects are rendered for transition_ms and their
+ * frames are blended, the old one keeps moving until it is gone.
+ *
+ * @param params LED effect parameters
+ * @param kind Command
+ * @param value Argument, see led_command_kind_t
+ * @return ESP_ERR_INVALID_ARG for a value out of range, ESP_ERR_TIMEOUT if
+ *         the queue is full (the render task is stuck)
+ */
+esp_err_t led_render_send(led_effect_params_t *params, led_command_kind_t kind,
+                          int32_t value);
+
+/**
+ * @brief Request a new value for a parameter of an effect
+ *
+ * The render task stores it between frames, an effect never sees a
+ * parameter change in the middle of a frame. Requests are not queued, a
+ * newer value for the same parameter replaces a pending one. Values start
+ * at the defaults of the effects when the task is started.
+ *
+ * @param params LED effect parameters
+ * @param effect_index Effect, need not be the active one
+ * @param param_index Index into the params of the effect
+ * @param value New value
+ * @return ESP_ERR_INVALID_ARG for an unknown parameter or a value out of
+ *         its range
+ */
+esp_err_t led_render_set_param(led_effect_params_t *params, int effect_index,
+                               int param_index, int32_t value);
+
+/**
+ * @brief Current value of a parameter of an effect
+ * @param params LED effect parameters of a started render task
+ * @param effect_index Effect
+ * @param param_index Index into the params of the effect
+ * @return Value, the applied one; a pending change is not seen yet
+ */
+static inline int32_t led_render_get_param(const led_effect_params_t *params,
+                                           int effect_index, int param_index) {
+  return params->param_values[effect_index * EFFECT_MAX_PARAMS + param_index];
+}
+
+/**
+ * @brief Select the wire format, takes effect with the next frame
+ * @param params LED effect parameters
+ * @param format Wire format
+ * @return ESP_ERR_INVALID_ARG if the format is unknown or does not fit the
+ *         wire buffers
+ */
+esp_err_t led_render_set_pixel_format(led_effect_params_t *params,
+                                      led_pixel_format_t format);
+
+/**
+ * @brief Rebuild the pixel map from a panel layout
+ *
+ * The render task builds the map between frames, it is the only writer of
+ * params->pixel_map. A later layout or custom map replaces a pending one.
+ *
+ * @param params LED effect parameters of a started render task
+ * @param layout Panel wiring
+ * @return ESP_ERR_INVALID_ARG for a rotation that is not a quarter turn,
+ *         ESP_ERR_INVALID_STATE before the task is started
+ */
+esp_err_t led_render_set_layout(led_effect_params_t *params,
+                                const led_layout_t *layout);
+
+/**
+ * @brief Replace the pixel map with a custom table
+ *
+ * The table is copied and handed to the render task, which installs it
+ * between frames. A frame is never packed with a partly updated map.
+ *
+ * @param params LED effect parameters of a started render task
+ * @param map Strip position of every LED
+ * @param count Number of entries, must equal the LED count
+ * @return ESP_ERR_INVALID_SIZE for a wrong count, ESP_ERR_INVALID_ARG if the
+ *         table is not a permutation, ESP_ERR_INVALID_STATE before the task
+ *         is started
+ */
+esp_err_t led_render_set_pixel_map(led_effect_params_t *params,
+                                   const uint16_t *map, size_t count);
 
 #ifdef __cplusplus
 }
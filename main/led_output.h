@@ -0,0 +1,110 @@
+/*
+ * LED Output Stage
+ *
+ * Final per-frame pass between the renderers and the strip. Effects render
+ * at full scale, the output stage applies gamma correction and the global
+ * brightness to the whole frame with a single lookup table. The table keeps
+ * 8 fractional bits per channel; the fraction is carried over to the next
+ * frame (temporal error diffusion), so dim levels between two 8-bit steps
+ * are reproduced on average instead of being truncated. Pure logic, builds
+ * on a host.
+ */
+
+#ifndef LED_OUTPUT_H
+#define LED_OUTPUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LED_OUTPUT_GAMMA 2.2 // Gamma of gamma_table in led_output.c
+
+// Dithering an unchanged frame is worth its frames only where a step of one
+// level is visible: on channels below this output level, and for a while
+// after the last change. A full cycle of the residual is 256 frames.
+#define LED_OUTPUT_DITHER_LEVEL 8
+#define LED_OUTPUT_DITHER_FRAMES 256
+
+typedef struct {
+  uint16_t lut[256];  // Channel value -> gamma corrected, scaled 8.8 value
+  uint8_t *residual;  // Fraction carried to the next frame, one per channel
+  size_t residual_len;
+  uint8_t brightness; // Brightness the table was built for, 0 = not built
+  uint16_t dither_frames; // Unchanged frames still to dither
+} led_output_t;
+
+/**
+ * @brief Initialize the output stage
+ *
+ * The residual buffer is seeded with a scrambled pattern, so channels with
+ * the same value do not all step up on the same frame.
+ *
+ * @param output Output stage
+ * @param residual Dithering state, one byte per channel byte of the frame
+ * @param len Size of the residual buffer
+ */
+void led_output_init(led_output_t *output, uint8_t *residual, size_t len);
+
+/**
+ * @brief Set the global brightness
+ *
+ * The lookup table is rebuilt only when the level actually changes, so
+ * this is cheap to call once per frame.
+ *
+ * @param output Output stage
+ * @param brightness Brightness level (1-255)
+ */
+void led_output_set_brightness(led_output_t *output, uint8_t brightness);
+
+/**
+ * @brief Apply gamma, brightness and dithering to a frame in place
+ *
+ * Fixed cost per channel byte: one table load, an add and two stores.
+ *
+ * @param output Output stage
+ * @param pixels Channel bytes of the frame
+ * @param len Number of bytes, at most the residual size given to init
+ */
+void led_output_apply(const led_output_t *output, uint8_t *pixels, size_t len);
+
+/**
+ * @brief Check whether the next, unchanged frame still has to be applied
+ *
+ * A dim channel between two output levels steps over time, so its frame
+ * has to be applied and sent even if the effect did not change it. Only
+ * channels below LED_OUTPUT_DITHER_LEVEL count, and an unchanged frame is
+ * dithered for LED_OUTPUT_DITHER_FRAMES frames at most. After that the
+ * output holds still and a static scene costs nothing.
+ *
+ * @param output Output stage with the brightness set
+ * @param changed The frame or the brightness changed since the last call
+ * @param pixels Channel bytes of the frame, before led_output_apply()
+ * @param len Number of bytes
+ * @return true if the next frame has to be applied even when unchanged
+ */
+bool led_output_dithers(led_output_t *output, bool changed,
+                        const uint8_t *pixels, size_t len);
+
+/**
+ * @brief Cross-fade two rendered frames, before led_output_apply()
+ *
+ * Blends render values, so the gamma of the output stage makes the fade
+ * look even to the eye.
+ *
+ * @param pixels Frame faded in, replaced by the blend
+ * @param from Frame faded out
+ * @param len Number of channel bytes
+ * @param alpha Share of pixels in 1/256: 0 gives from, 256 gives pixels
+ */
+void led_output_blend(uint8_t *pixels, const uint8_t *from, size_t len,
+                      uint16_t alpha);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LED_OUTPUT_H
@@ -0,0 +1,141 @@
+/*
+ * LED Pack Stage Implementation
+ */
+
+#include "led_pack.h"
+#include <string.h>
+
+typedef struct {
+  const char *name;
+  uint8_t bytes_per_pixel;
+  uint8_t offset[3]; // Wire position of red, green and blue
+} pixel_format_info_t;
+
+static const pixel_format_info_t formats[LED_PIXEL_FORMAT_COUNT] = {
+    [LED_PIXEL_GRB] = {"GRB", 3, {1, 0, 2}},
+    [LED_PIXEL_RGB] = {"RGB", 3, {0, 1, 2}},
+    [LED_PIXEL_BGR] = {"BGR", 3, {2, 1, 0}},
+    [LED_PIXEL_GRBW] = {"GRBW", 4, {1, 0, 2}},
+};
+
+size_t led_pack_bytes_per_pixel(led_pixel_format_t format) {
+  return format < LED_PIXEL_FORMAT_COUNT ? formats[format].bytes_per_pixel
+                                         : 3;
+}
+
+const char *led_pack_format_name(led_pixel_format_t format) {
+  return format < LED_PIXEL_FORMAT_COUNT ? formats[format].name : "unknown";
+}
+
+bool led_pack_format_from_name(const char *name, led_pixel_format_t *format) {
+  for (int i = 0; i < LED_PIXEL_FORMAT_COUNT; i++) {
+    if (strcmp(name, formats[i].name) == 0) {
+      *format = (led_pixel_format_t)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool led_pack_build_map(const led_layout_t *layout, uint16_t width,
+                        uint16_t height, uint16_t *map) {
+  if (!led_layout_valid(layout)) {
+    return false;
+  }
+  bool quarter_turn = layout->rotation == 90 || layout->rotation == 270;
+  // Size of the physical panel
+  uint16_t panel_width = quarter_turn ? height : width;
+
+  for (uint16_t y = 0; y < height; y++) {
+    for (uint16_t x = 0; x < width; x++) {
+      uint16_t fx = layout->flip_x ? width - 1 - x : x;
+      uint16_t fy = layout->flip_y ? height - 1 - y : y;
+      uint16_t px, py;
+      switch (layout->rotation) {
+      case 90:
+        px = height - 1 - fy;
+        py = fx;
+        break;
+      case 180:
+        px = width - 1 - fx;
+        py = height - 1 - fy;
+        break;
+      case 270:
+        px = fy;
+        py = width - 1 - fx;
+        break;
+      default:
+        px = fx;
+        py = fy;
+        break;
+      }
+      if (layout->serpentine && (py & 1)) {
+        px = panel_width - 1 - px;
+      }
+      map[y * width + x] = py * panel_width + px;
+    }
+  }
+  return true;
+}
+
+bool led_pack_map_valid(const uint16_t *map, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (map[i] >= count) {
+      return false;
+    }
+    for (size_t j = 0; j < i; j++) {
+      if (map[j] == map[i]) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void led_pack_split(uint16_t count, uint8_t channels,
+                    led_segment_t *segments) {
+  uint16_t base = count / channels;
+  uint16_t extra = count % channels;
+  uint16_t first = 0;
+
+  // The first channels take one LED more when the split is uneven
+  for (uint8_t i = 0; i < channels; i++) {
+    segments[i].first = first;
+    segments[i].count = base + (i < extra ? 1 : 0);
+    first += segments[i].count;
+  }
+}
+
+size_t led_pack(led_pixel_format_t format, const uint8_t *rgb, uint8_t *wire,
+                size_t count, const uint16_t *map) {
+  if (format >= LED_PIXEL_FORMAT_COUNT) {
+    format = LED_PIXEL_GRB;
+  }
+  const pixel_format_info_t *info = &formats[format];
+  const size_t bpp = info->bytes_per_pixel;
+  const uint8_t r_off = info->offset[0];
+  const uint8_t g_off = info->offset[1];
+  const uint8_t b_off = info->offset[2];
+
+  // Pixels are read in order and scattered to their strip positions
+  if (bpp == 4) {
+    // The part common to all three channels goes to the white LED
+    for (size_t i = 0; i < count; i++, rgb += 3) {
+      uint8_t *out = wire + (map ? map[i] : i) * 4;
+      uint8_t white = rgb[0] < rgb[1] ? rgb[0] : rgb[1];
+      white = rgb[2] < white ? rgb[2] : white;
+      out[r_off] = rgb[0] - white;
+      out[g_off] = rgb[1] - white;
+      out[b_off] = rgb[2] - white;
+      out[3] = white;
+    }
+  } else {
+    for (size_t i = 0; i < count; i++, rgb += 3) {
+      uint8_t *out = wire + (map ? map[i] : i) * 3;
+      out[r_off] = rgb[0];
+      out[g_off] = rgb[1];
+      out[b_off] = rgb[2];
+    }
+  }
+  return count * bpp;
+}
@@ -0,0 +1,131 @@
+/*
+ * LED Pack Stage
+ *
+ * Effects render into a canonical RGB frame. The pack stage converts it to
+ * the byte layout the strip expects on the wire, so one firmware image
+ * drives strips with any color order. It also moves every pixel to its
+ * physical position on the strip through a precomputed map, so effects
+ * address the matrix row by row whatever the wiring. Strip positions can be
+ * split over several output channels that are sent in parallel. Pure
+ * logic, builds on a host.
+ */
+
+#ifndef LED_PACK_H
+#define LED_PACK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LED_PACK_MAX_BYTES_PER_PIXEL 4 // Size wire buffers for any format
+
+// Wire formats, values are stored in NVS and must not be reordered
+typedef enum {
+  LED_PIXEL_GRB = 0,  // WS2812, WS2812B
+  LED_PIXEL_RGB = 1,  // WS2811 and some clones
+  LED_PIXEL_BGR = 2,  // Some APA106 batches
+  LED_PIXEL_GRBW = 3, // SK6812 RGBW, white channel from the common part
+  LED_PIXEL_FORMAT_COUNT,
+} led_pixel_format_t;
+
+// Wiring of a matrix panel, turned into a pixel map once
+typedef struct {
+  bool serpentine;   // Every other physical row runs backwards
+  uint16_t rotation; // Panel rotation clockwise: 0, 90, 180 or 270 degrees
+  bool flip_x;       // Mirror columns before rotating
+  bool flip_y;       // Mirror rows before rotating
+} led_layout_t;
+
+// The rotation is the only field that can be out of range
+static inline bool led_layout_valid(const led_layout_t *layout) {
+  return layout->rotation % 90 == 0 && layout->rotation < 360;
+}
+
+// Strip positions sent by one output channel
+typedef struct {
+  uint16_t first; // First strip position
+  uint16_t count; // Number of LEDs
+} led_segment_t;
+
+/**
+ * @brief Bytes per pixel on the wire
+ * @param format Wire format
+ * @return 3 or 4
+ */
+size_t led_pack_bytes_per_pixel(led_pixel_format_t format);
+
+/**
+ * @brief Name of a wire format, "GRB", "RGB", "BGR" or "GRBW"
+ * @param format Wire format
+ * @return Name, "unknown" for an invalid format
+ */
+const char *led_pack_format_name(led_pixel_format_t format);
+
+/**
+ * @brief Look up a wire format by name
+ * @param name Name as returned by led_pack_format_name()
+ * @param format Set to the format when found
+ * @return true if the name is known
+ */
+bool led_pack_format_from_name(const char *name, led_pixel_format_t *format);
+
+/**
+ * @brief Build the pixel map of a panel layout
+ *
+ * map[i] is the position on the strip of LED i of the row by row matrix
+ * the effects draw.
+ *
+ * @param layout Panel wiring
+ * @param width Matrix width as seen by the effects
+ * @param height Matrix height as seen by the effects
+ * @param map Destination, width * height entries
+ * @return false if the rotation is not a multiple of 90 degrees
+ */
+bool led_pack_build_map(const led_layout_t *layout, uint16_t width,
+                        uint16_t height, uint16_t *map);
+
+/**
+ * @brief Check that a custom map is a permutation of 0 .. count - 1
+ *
+ * Quadratic, meant for validating uploaded maps, not for the frame loop.
+ *
+ * @param map Pixel map
+ * @param count Number of entries
+ * @return true if every strip position is used exactly once
+ */
+bool led_pack_map_valid(const uint16_t *map, size_t count);
+
+/**
+ * @brief Split the strip positions over output channels
+ *
+ * Channels get consecutive runs of the strip that differ by at most one
+ * LED, so all of them finish sending at about the same time.
+ *
+ * @param count Number of LEDs
+ * @param channels Number of channels (at least 1)
+ * @param segments Destination, one entry per channel
+ */
+void led_pack_split(uint16_t count, uint8_t channels,
+                    led_segment_t *segments);
+
+/**
+ * @brief Convert an RGB frame to the wire format
+ * @param format Wire format
+ * @param rgb Source frame, 3 bytes per pixel
+ * @param wire Destination, count * led_pack_bytes_per_pixel() bytes
+ * @param count Number of pixels
+ * @param map Strip position of every pixel, NULL for progressive wiring
+ * @return Number of bytes written to wire
+ */
+size_t led_pack(led_pixel_format_t format, const uint8_t *rgb, uint8_t *wire,
+                size_t count, const uint16_t *map);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LED_PACK_H
@@ -0,0 +1,58 @@
+/*
+ * LED SPI Encoder Implementation
+ */
+
+#include "led_spi_encoder.h"
+#include <string.h>
+
+// SPI bits of a nibble, MSB first: 4 x 3 bits
+static const uint16_t nibble_bits3[16] = {
+    0x924, 0x926, 0x934, 0x936, 0x9A4, 0x9A6, 0x9B4, 0x9B6,
+    0xD24, 0xD26, 0xD34, 0xD36, 0xDA4, 0xDA6, 0xDB4, 0xDB6,
+};
+
+// SPI bits of a nibble, MSB first: 4 x 4 bits
+static const uint16_t nibble_bits4[16] = {
+    0x8888, 0x888E, 0x88E8, 0x88EE, 0x8E88, 0x8E8E, 0x8EE8, 0x8EEE,
+    0xE888, 0xE88E, 0xE8E8, 0xE8EE, 0xEE88, 0xEE8E, 0xEEE8, 0xEEEE,
+};
+
+// Whole bytes of low level that cover the reset time
+static size_t reset_size(led_spi_bits_t bits, uint16_t reset_us) {
+  uint32_t reset_bits =
+      ((uint32_t)led_spi_clock_hz(bits) / 1000 * reset_us + 999) / 1000;
+  return (reset_bits + 7) / 8;
+}
+
+size_t led_spi_frame_size(led_spi_bits_t bits, size_t len, uint16_t reset_us) {
+  return len * bits + reset_size(bits, reset_us);
+}
+
+size_t led_spi_encode(led_spi_bits_t bits, const uint8_t *wire, size_t len,
+                      uint16_t reset_us, uint8_t *out) {
+  uint8_t *start = out;
+
+  // Every input byte is two table lookups, written as 3 or 4 whole bytes
+  if (bits == LED_SPI_BITS_3) {
+    for (size_t i = 0; i < len; i++, out += 3) {
+      uint32_t value = (uint32_t)nibble_bits3[wire[i] >> 4] << 12 |
+                       nibble_bits3[wire[i] & 0x0F];
+      out[0] = (uint8_t)(value >> 16);
+      out[1] = (uint8_t)(value >> 8);
+      out[2] = (uint8_t)value;
+    }
+  } else {
+    for (size_t i = 0; i < len; i++, out += 4) {
+      uint16_t high = nibble_bits4[wire[i] >> 4];
+      uint16_t low = nibble_bits4[wire[i] & 0x0F];
+      out[0] = (uint8_t)(high >> 8);
+      out[1] = (uint8_t)high;
+      out[2] = (uint8_t)(low >> 8);
+      out[3] = (uint8_t)low;
+    }
+  }
+
+  size_t reset = reset_size(bits, reset_us);
+  memset(out, 0, reset);
+  return (size_t)(out - start) + reset;
+}
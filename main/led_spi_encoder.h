@@ -0,0 +1,62 @@
+/*
+ * LED SPI Encoder
+ *
+ * Expands wire bytes into an SPI bit stream that reproduces the WS2812
+ * waveform on MOSI: every LED bit becomes 3 or 4 SPI bits with a short or
+ * long high pulse. The expanded frame is sent by DMA, the CPU only fills
+ * the buffer. Pure logic, builds on a host.
+ */
+
+#ifndef LED_SPI_ENCODER_H
+#define LED_SPI_ENCODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LED_SPI_BIT_RATE_HZ 800000 // WS2812 data rate, 1.25 us per LED bit
+
+// SPI bits per LED bit, the SPI clock is LED_SPI_BIT_RATE_HZ times this
+typedef enum {
+  LED_SPI_BITS_3 = 3, // 2.4 MHz: 0 = 100, 1 = 110
+  LED_SPI_BITS_4 = 4, // 3.2 MHz: 0 = 1000, 1 = 1110
+} led_spi_bits_t;
+
+/**
+ * @brief SPI clock for an encoding
+ * @param bits SPI bits per LED bit
+ * @return Clock in Hz
+ */
+static inline int led_spi_clock_hz(led_spi_bits_t bits) {
+  return (int)bits * LED_SPI_BIT_RATE_HZ;
+}
+
+/**
+ * @brief Size of an encoded frame including the trailing reset
+ * @param bits SPI bits per LED bit
+ * @param len Number of wire bytes
+ * @param reset_us Low time that latches the frame, see led_timing_reset_us()
+ * @return Bytes written by led_spi_encode()
+ */
+size_t led_spi_frame_size(led_spi_bits_t bits, size_t len, uint16_t reset_us);
+
+/**
+ * @brief Expand wire bytes into the SPI bit stream, MSB first
+ * @param bits SPI bits per LED bit
+ * @param wire Packed frame
+ * @param len Number of wire bytes
+ * @param reset_us Low time that latches the frame
+ * @param out Destination, led_spi_frame_size() bytes
+ * @return Number of bytes written to out
+ */
+size_t led_spi_encode(led_spi_bits_t bits, const uint8_t *wire, size_t len,
+                      uint16_t reset_us, uint8_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LED_SPI_ENCODER_H
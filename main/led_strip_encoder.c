@@ -81,19 +81,23 @@ esp_err_t rmt_new_led_strip_encoder(const led_strip_encoder_config_t *config, rm
     led_encoder->base.encode = rmt_encode_led_strip;
     led_encoder->base.del = rmt_del_led_strip_encoder;
     led_encoder->base.reset = rmt_led_strip_encoder_reset;
-    // different led strip might have its own timing requirements, following parameter is for WS2812
+    // different led strip might have its own timing requirements, they come from the chip profile
+    const led_timing_t *timing = led_timing_get(config->chip);
+    led_timing_ticks_t ticks;
+    ESP_GOTO_ON_FALSE(led_timing_to_ticks(timing, config->resolution, config->min_reset, &ticks),
+                      ESP_ERR_INVALID_ARG, err, TAG, "%s timing does not fit the resolution", timing->name);
     rmt_bytes_encoder_config_t bytes_encoder_config = {
         .bit0 = {
             .level0 = 1,
-            .duration0 = 0.3 * config->resolution / 1000000, // T0H=0.3us
+            .duration0 = ticks.t0h,
             .level1 = 0,
-            .duration1 = 0.9 * config->resolution / 1000000, // T0L=0.9us
+            .duration1 = ticks.t0l,
         },
         .bit1 = {
             .level0 = 1,
-            .duration0 = 0.9 * config->resolution / 1000000, // T1H=0.9us
+            .duration0 = ticks.t1h,
             .level1 = 0,
-            .duration1 = 0.3 * config->resolution / 1000000, // T1L=0.3us
+            .duration1 = ticks.t1l,
         },
         .flags.msb_first = 1 // WS2812 transfer bit order: G7...G0R7...R0B7...B0
     };
@@ -101,12 +105,11 @@ esp_err_t rmt_new_led_strip_encoder(const led_strip_encoder_config_t *config, rm
     rmt_copy_encoder_config_t copy_encoder_config = {};
     ESP_GOTO_ON_ERROR(rmt_new_copy_encoder(&copy_encoder_config, &led_encoder->copy_encoder), err, TAG, "create copy encoder failed");
 
-    uint32_t reset_ticks = config->resolution / 1000000 * 50 / 2; // reset code duration defaults to 50us
     led_encoder->reset_code = (rmt_symbol_word_t) {
         .level0 = 0,
-        .duration0 = reset_ticks,
+        .duration0 = ticks.reset_half,
         .level1 = 0,
-        .duration1 = reset_ticks,
+        .duration1 = ticks.reset_half,
     };
     *ret_encoder = &led_encoder->base;
     return ESP_OK;
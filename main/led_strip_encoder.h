@@ -5,8 +5,10 @@
  */
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 #include "driver/rmt_encoder.h"
+#include "led_timing.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -17,6 +19,8 @@ extern "C" {
  */
 typedef struct {
     uint32_t resolution; /*!< Encoder resolution, in Hz */
+    led_chip_t chip;     /*!< Timing profile, WS2812B when zero-initialized */
+    bool min_reset;      /*!< Send the shortest reset the chip allows */
 } led_strip_encoder_config_t;
 
 /**
@@ -25,7 +29,7 @@ typedef struct {
  * @param[in] config Encoder configuration
  * @param[out] ret_encoder Returned encoder handle
  * @return
- *      - ESP_ERR_INVALID_ARG for any invalid arguments
+ *      - ESP_ERR_INVALID_ARG for any invalid arguments, also a timing that does not fit the resolution
  *      - ESP_ERR_NO_MEM out of memory when creating led strip encoder
  *      - ESP_OK if creating encoder successfully
  */
@@ -0,0 +1,52 @@
+/*
+ * LED Chip Timing Implementation
+ */
+
+#include "led_timing.h"
+#include <string.h>
+
+static const led_timing_t timings[LED_CHIP_COUNT] = {
+    // WS2812B V5 latches after 280 us, older batches after 50 us
+    [LED_CHIP_WS2812B] = {"WS2812B", 400, 850, 800, 450, 300, 280},
+    [LED_CHIP_WS2811] = {"WS2811", 500, 2000, 1200, 1300, 80, 50},
+    [LED_CHIP_SK6812] = {"SK6812", 300, 900, 600, 600, 100, 80},
+    [LED_CHIP_WS2815] = {"WS2815", 300, 1000, 1000, 300, 300, 280},
+};
+
+const led_timing_t *led_timing_get(led_chip_t chip) {
+  return &timings[chip < LED_CHIP_COUNT ? chip : LED_CHIP_WS2812B];
+}
+
+bool led_timing_from_name(const char *name, led_chip_t *chip) {
+  for (int i = 0; i < LED_CHIP_COUNT; i++) {
+    if (strcmp(name, timings[i].name) == 0) {
+      *chip = (led_chip_t)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Tick count rounded to nearest or up, 0 when it does not fit a symbol half
+static uint16_t to_ticks(uint64_t duration_ns, uint32_t resolution_hz,
+                         bool round_up) {
+  const uint64_t ns_per_s = 1000000000ULL;
+  uint64_t scaled = duration_ns * resolution_hz;
+  uint64_t ticks = (scaled + (round_up ? ns_per_s - 1 : ns_per_s / 2)) /
+                   ns_per_s;
+  return ticks <= LED_TIMING_MAX_TICKS ? (uint16_t)ticks : 0;
+}
+
+bool led_timing_to_ticks(const led_timing_t *timing, uint32_t resolution_hz,
+                         bool min_reset, led_timing_ticks_t *ticks) {
+  uint16_t reset_us = led_timing_reset_us(timing, min_reset);
+
+  ticks->t0h = to_ticks(timing->t0h_ns, resolution_hz, false);
+  ticks->t0l = to_ticks(timing->t0l_ns, resolution_hz, false);
+  ticks->t1h = to_ticks(timing->t1h_ns, resolution_hz, false);
+  ticks->t1l = to_ticks(timing->t1l_ns, resolution_hz, false);
+  // A reset must never be shorter than asked for
+  ticks->reset_half = to_ticks((uint64_t)reset_us * 500, resolution_hz, true);
+  return ticks->t0h && ticks->t0l && ticks->t1h && ticks->t1l &&
+         ticks->reset_half;
+}
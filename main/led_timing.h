@@ -0,0 +1,92 @@
+/*
+ * LED Chip Timing
+ *
+ * Bit and reset timings of the supported LED chips and their conversion
+ * to RMT ticks. The reset is the low time after which the chips latch a
+ * frame; the minimal reset of a chip lets frames follow each other
+ * sooner. Pure logic, builds on a host.
+ */
+
+#ifndef LED_TIMING_H
+#define LED_TIMING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LED_TIMING_MAX_TICKS 32767 // Duration field of an RMT symbol half
+
+// Chips, values are stored in NVS and must not be reordered
+typedef enum {
+  LED_CHIP_WS2812B = 0,
+  LED_CHIP_WS2811 = 1, // 400 kHz slow mode
+  LED_CHIP_SK6812 = 2,
+  LED_CHIP_WS2815 = 3,
+  LED_CHIP_COUNT,
+} led_chip_t;
+
+// Datasheet timing of a chip
+typedef struct {
+  const char *name;
+  uint16_t t0h_ns;       // High time of a 0 bit
+  uint16_t t0l_ns;       // Low time of a 0 bit
+  uint16_t t1h_ns;       // High time of a 1 bit
+  uint16_t t1l_ns;       // Low time of a 1 bit
+  uint16_t reset_us;     // Reset with margin for clones and long cables
+  uint16_t min_reset_us; // Shortest reset the datasheet allows
+} led_timing_t;
+
+// Timing converted to ticks of the RMT resolution
+typedef struct {
+  uint16_t t0h;
+  uint16_t t0l;
+  uint16_t t1h;
+  uint16_t t1l;
+  uint16_t reset_half; // The reset is sent as a symbol of two equal halves
+} led_timing_ticks_t;
+
+/**
+ * @brief Timing of a chip
+ * @param chip Chip
+ * @return Timing, WS2812B for an unknown chip
+ */
+const led_timing_t *led_timing_get(led_chip_t chip);
+
+/**
+ * @brief Look up a chip by name
+ * @param name Name as in led_timing_t, e.g. "WS2812B"
+ * @param chip Set to the chip when found
+ * @return true if the name is known
+ */
+bool led_timing_from_name(const char *name, led_chip_t *chip);
+
+/**
+ * @brief Reset length to send after a frame
+ * @param timing Chip timing
+ * @param min_reset Use the minimal reset instead of the one with margin
+ * @return Low time in microseconds
+ */
+static inline uint16_t led_timing_reset_us(const led_timing_t *timing,
+                                           bool min_reset) {
+  return min_reset ? timing->min_reset_us : timing->reset_us;
+}
+
+/**
+ * @brief Convert a timing to ticks, rounded to the nearest tick
+ * @param timing Chip timing
+ * @param resolution_hz Tick rate
+ * @param min_reset Use the minimal reset instead of the one with margin
+ * @param ticks Destination
+ * @return false if a duration rounds to 0 ticks or does not fit a symbol
+ */
+bool led_timing_to_ticks(const led_timing_t *timing, uint32_t resolution_hz,
+                         bool min_reset, led_timing_ticks_t *ticks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LED_TIMING_H
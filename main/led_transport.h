@@ -0,0 +1,136 @@
+/*
+ * LED Transport
+ *
+ * Sends packed wire frames to the strip. The render task only talks to
+ * this interface, the backend is picked once at init:
+ * - RMT: one or more channels, the encoder refills RMT memory from
+ *   interrupts while the frame is sent.
+ * - SPI: the frame is expanded into an SPI bit stream and sent by DMA in
+ *   one transaction, no interrupts per LED.
+ */
+
+#ifndef LED_TRANSPORT_H
+#define LED_TRANSPORT_H
+
+#include "driver/gpio.h"
+#include "driver/spi_master.h"
+#include "esp_err.h"
+#include "led_spi_encoder.h"
+#include "led_timing.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LED_MAX_CHANNELS 2 // TX channels of the ESP32-C3 RMT
+
+// Backends, values are stored in NVS and must not be reordered
+typedef enum {
+  LED_TRANSPORT_RMT = 0,
+  LED_TRANSPORT_SPI = 1,
+  LED_TRANSPORT_COUNT,
+} led_transport_kind_t;
+
+typedef struct led_transport_t led_transport_t;
+
+// Backends embed this structure and recover themselves with __containerof
+struct led_transport_t {
+  /**
+   * @brief Start sending a frame
+   *
+   * Waits until the previous frame has left, then returns while this one
+   * is being sent. wire must stay untouched until the next call.
+   *
+   * @param transport Transport
+   * @param wire Packed frame
+   * @param count Number of LEDs
+   * @param bytes_per_pixel Wire bytes of one LED
+   */
+  esp_err_t (*transmit)(led_transport_t *transport, const uint8_t *wire,
+                        size_t count, size_t bytes_per_pixel);
+
+  /**
+   * @brief Wait until the last frame has left
+   * @param transport Transport
+   * @param timeout_ms Timeout in milliseconds
+   */
+  esp_err_t (*wait_done)(led_transport_t *transport, int timeout_ms);
+
+  /**
+   * @brief Release the peripheral and free the transport
+   * @param transport Transport
+   */
+  esp_err_t (*del)(led_transport_t *transport);
+};
+
+typedef struct {
+  const gpio_num_t *gpios; // Data pin of every channel
+  uint8_t channel_count;   // 1 .. LED_MAX_CHANNELS, the strip is split evenly
+  uint32_t resolution_hz;  // RMT tick rate
+  led_chip_t chip;         // Bit and reset timing of the LEDs
+  bool min_reset;          // Shortest reset the chip allows between frames
+} led_transport_rmt_config_t;
+
+// The SPI bit patterns follow WS2812B timing, other chips need RMT (see
+// led_transport_supports_chip). The reset after a frame comes from the chip
+// profile like on RMT.
+typedef struct {
+  gpio_num_t gpio;        // Data pin, driven as MOSI
+  spi_host_device_t host; // SPI peripheral, SPI2_HOST on the ESP32-C3
+  led_spi_bits_t bits;    // SPI bits per LED bit
+  led_chip_t chip;        // Reset timing of the LEDs
+  bool min_reset;         // Shortest reset the chip allows between frames
+  size_t max_bytes;       // Largest wire frame, sizes the DMA buffer
+} led_transport_spi_config_t;
+
+/**
+ * @brief Create an RMT transport
+ * @param config Transport configuration
+ * @param ret_transport Returned transport
+ * @return ESP_ERR_INVALID_ARG for a bad channel count, ESP_ERR_NO_MEM or an
+ *         RMT driver error
+ */
+esp_err_t led_transport_new_rmt(const led_transport_rmt_config_t *config,
+                                led_transport_t **ret_transport);
+
+/**
+ * @brief Create an SPI transport with a DMA buffer for the largest frame
+ * @param config Transport configuration
+ * @param ret_transport Returned transport
+ * @return ESP_ERR_INVALID_ARG for bad arguments, ESP_ERR_NO_MEM or an SPI
+ *         driver error
+ */
+esp_err_t led_transport_new_spi(const led_transport_spi_config_t *config,
+                                led_transport_t **ret_transport);
+
+static inline const char *led_transport_name(led_transport_kind_t kind) {
+  return kind == LED_TRANSPORT_SPI ? "spi" : "rmt";
+}
+
+static inline bool led_transport_from_name(const char *name,
+                                           led_transport_kind_t *kind) {
+  for (int i = 0; i < LED_TRANSPORT_COUNT; i++) {
+    if (strcmp(name, led_transport_name((led_transport_kind_t)i)) == 0) {
+      *kind = (led_transport_kind_t)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+// The SPI bit patterns are fixed WS2812B pulses: slower chips (WS2811) or
+// other high times (SK6812, WS2815) would get an out of spec waveform
+static inline bool led_transport_supports_chip(led_transport_kind_t kind,
+                                               led_chip_t chip) {
+  return kind != LED_TRANSPORT_SPI || chip == LED_CHIP_WS2812B;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LED_TRANSPORT_H
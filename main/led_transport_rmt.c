@@ -0,0 +1,197 @@
+/*
+ * LED Transport over RMT
+ */
+
+#include "driver/rmt_tx.h"
+#include "esp_attr.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "led_pack.h"
+#include "led_strip_encoder.h"
+#include "led_transport.h"
+#include "soc/soc_caps.h"
+#include <stdlib.h>
+
+static const char *TAG = "led_transport_rmt";
+
+typedef struct {
+  led_transport_t base;
+  rmt_channel_handle_t channels[LED_MAX_CHANNELS];
+  rmt_encoder_handle_t encoders[LED_MAX_CHANNELS]; // Encoder of each channel
+  uint8_t channel_count;
+  rmt_sync_manager_handle_t sync; // Starts all channels together or NULL
+  SemaphoreHandle_t tx_done; // Counts channels done sending, given from ISR
+  rmt_transmit_config_t tx_config;
+} led_transport_rmt_t;
+
+static bool IRAM_ATTR on_tx_done(rmt_channel_handle_t channel,
+                                 const rmt_tx_done_event_data_t *edata,
+                                 void *user_ctx) {
+  led_transport_rmt_t *rmt = (led_transport_rmt_t *)user_ctx;
+  BaseType_t high_task_wakeup = pdFALSE;
+  xSemaphoreGiveFromISR(rmt->tx_done, &high_task_wakeup);
+  return high_task_wakeup == pdTRUE;
+}
+
+static esp_err_t rmt_transport_transmit(led_transport_t *transport,
+                                        const uint8_t *wire, size_t count,
+                                        size_t bytes_per_pixel) {
+  led_transport_rmt_t *rmt =
+      __containerof(transport, led_transport_rmt_t, base);
+  // Every channel needs at least one LED to send
+  if (count < rmt->channel_count) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  // Every channel must finish the previous frame before its buffer is reused
+  for (uint8_t i = 0; i < rmt->channel_count; i++) {
+    if (xSemaphoreTake(rmt->tx_done, pdMS_TO_TICKS(500)) != pdTRUE) {
+      // Продолжаем выполнение даже при таймауте
+      ESP_LOGW(TAG, "RMT wait timeout, continuing anyway");
+      break;
+    }
+  }
+
+  // With a sync manager the channels start together once all are queued
+  led_segment_t segments[LED_MAX_CHANNELS];
+  led_pack_split(count, rmt->channel_count, segments);
+  esp_err_t ret = ESP_OK;
+  for (uint8_t i = 0; i < rmt->channel_count; i++) {
+    esp_err_t err = rmt_transmit(rmt->channels[i], rmt->encoders[i],
+                                 wire + segments[i].first * bytes_per_pixel,
+                                 segments[i].count * bytes_per_pixel,
+                                 &rmt->tx_config);
+    if (err != ESP_OK) {
+      ESP_LOGE(TAG, "RMT transmit on channel %u failed: %s", i,
+               esp_err_to_name(err));
+      // No TX-done event will follow, keep the semaphore available
+      xSemaphoreGive(rmt->tx_done);
+      ret = err;
+    }
+  }
+  if (ret != ESP_OK && rmt->sync) {
+    // Channels already queued would otherwise wait for the failed one
+    rmt_sync_reset(rmt->sync);
+  }
+  return ret;
+}
+
+static esp_err_t rmt_transport_wait_done(led_transport_t *transport,
+                                         int timeout_ms) {
+  led_transport_rmt_t *rmt =
+      __containerof(transport, led_transport_rmt_t, base);
+  esp_err_t ret = ESP_OK;
+  for (uint8_t i = 0; i < rmt->channel_count && ret == ESP_OK; i++) {
+    ret = rmt_tx_wait_all_done(rmt->channels[i], timeout_ms);
+  }
+  return ret;
+}
+
+// Releases whatever has been created, also for a partly built transport
+static void rmt_transport_release(led_transport_rmt_t *rmt) {
+  if (rmt->sync) {
+    rmt_del_sync_manager(rmt->sync);
+  }
+  for (uint8_t i = 0; i < LED_MAX_CHANNELS; i++) {
+    if (rmt->channels[i]) {
+      rmt_disable(rmt->channels[i]);
+      rmt_del_channel(rmt->channels[i]);
+    }
+    if (rmt->encoders[i]) {
+      rmt_del_encoder(rmt->encoders[i]);
+    }
+  }
+  if (rmt->tx_done) {
+    vSemaphoreDelete(rmt->tx_done);
+  }
+  free(rmt);
+}
+
+static esp_err_t rmt_transport_del(led_transport_t *transport) {
+  led_transport_rmt_t *rmt =
+      __containerof(transport, led_transport_rmt_t, base);
+  rmt_transport_wait_done(transport, 500);
+  rmt_transport_release(rmt);
+  return ESP_OK;
+}
+
+esp_err_t led_transport_new_rmt(const led_transport_rmt_config_t *config,
+                                led_transport_t **ret_transport) {
+  esp_err_t ret = ESP_OK;
+  led_transport_rmt_t *rmt = NULL;
+  ESP_GOTO_ON_FALSE(config && ret_transport && config->channel_count >= 1 &&
+                        config->channel_count <= LED_MAX_CHANNELS,
+                    ESP_ERR_INVALID_ARG, err, TAG, "invalid argument");
+  rmt = calloc(1, sizeof(led_transport_rmt_t));
+  ESP_GOTO_ON_FALSE(rmt, ESP_ERR_NO_MEM, err, TAG, "no mem for transport");
+  rmt->base.transmit = rmt_transport_transmit;
+  rmt->base.wait_done = rmt_transport_wait_done;
+  rmt->base.del = rmt_transport_del;
+  rmt->channel_count = config->channel_count;
+  rmt->tx_config = (rmt_transmit_config_t){.loop_count = 0}; // no loop
+
+  // Semaphore is created empty, give it once per channel: no frame is in
+  // flight yet
+  rmt->tx_done = xSemaphoreCreateCounting(LED_MAX_CHANNELS, 0);
+  ESP_GOTO_ON_FALSE(rmt->tx_done, ESP_ERR_NO_MEM, err, TAG,
+                    "no mem for TX-done semaphore");
+  for (uint8_t i = 0; i < rmt->channel_count; i++) {
+    xSemaphoreGive(rmt->tx_done);
+  }
+
+  // A single channel borrows the memory of the others to avoid flicker,
+  // parallel channels get one block each
+  size_t mem_block_symbols =
+      rmt->channel_count == 1 ? 128 : SOC_RMT_MEM_WORDS_PER_CHANNEL;
+  rmt_tx_event_callbacks_t callbacks = {.on_trans_done = on_tx_done};
+  for (uint8_t i = 0; i < rmt->channel_count; i++) {
+    ESP_LOGI(TAG, "Create RMT TX channel %u on GPIO %d", i, config->gpios[i]);
+    rmt_tx_channel_config_t tx_chan_config = {
+        .clk_src = RMT_CLK_SRC_DEFAULT, // select source clock
+        .gpio_num = config->gpios[i],
+        .mem_block_symbols = mem_block_symbols,
+        .resolution_hz = config->resolution_hz,
+        .trans_queue_depth = 8, // Увеличиваем глубину очереди транзакций
+    };
+    ESP_GOTO_ON_ERROR(rmt_new_tx_channel(&tx_chan_config, &rmt->channels[i]),
+                      err, TAG, "create RMT channel failed");
+
+    // The encoder keeps the position in the frame, one per channel
+    led_strip_encoder_config_t encoder_config = {
+        .resolution = config->resolution_hz,
+        .chip = config->chip,
+        .min_reset = config->min_reset,
+    };
+    ESP_GOTO_ON_ERROR(
+        rmt_new_led_strip_encoder(&encoder_config, &rmt->encoders[i]), err,
+        TAG, "create led strip encoder failed");
+
+    // RMT accepts callbacks only while the channel is disabled
+    ESP_GOTO_ON_ERROR(
+        rmt_tx_register_event_callbacks(rmt->channels[i], &callbacks, rmt),
+        err, TAG, "register RMT callbacks failed");
+    ESP_GOTO_ON_ERROR(rmt_enable(rmt->channels[i]), err, TAG,
+                      "enable RMT channel failed");
+  }
+
+  if (rmt->channel_count > 1) {
+    // All segments start on the same clock edge, the frame is not torn
+    rmt_sync_manager_config_t sync_config = {
+        .tx_channel_array = rmt->channels,
+        .array_size = rmt->channel_count,
+    };
+    ESP_GOTO_ON_ERROR(rmt_new_sync_manager(&sync_config, &rmt->sync), err,
+                      TAG, "create RMT sync manager failed");
+  }
+
+  *ret_transport = &rmt->base;
+  return ESP_OK;
+
+err:
+  if (rmt) {
+    rmt_transport_release(rmt);
+  }
+  return ret;
+}
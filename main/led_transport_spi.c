@@ -0,0 +1,160 @@
+/*
+ * LED Transport over SPI with DMA
+ */
+
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "led_transport.h"
+#include <stdlib.h>
+
+static const char *TAG = "led_transport_spi";
+
+typedef struct {
+  led_transport_t base;
+  spi_host_device_t host;
+  spi_device_handle_t device;
+  bool bus_initialized;
+  led_spi_bits_t bits;
+  uint16_t reset_us; // Low time sent after every frame
+  uint8_t *dma_buffer; // Encoded frame, read by DMA while it is sent
+  size_t dma_buffer_size;
+  spi_transaction_t transaction;
+  bool in_flight; // A transaction is queued and its result not yet taken
+} led_transport_spi_t;
+
+static esp_err_t spi_transport_wait_done(led_transport_t *transport,
+                                         int timeout_ms) {
+  led_transport_spi_t *spi =
+      __containerof(transport, led_transport_spi_t, base);
+  if (!spi->in_flight) {
+    return ESP_OK;
+  }
+  spi_transaction_t *done;
+  esp_err_t ret = spi_device_get_trans_result(spi->device, &done,
+                                              pdMS_TO_TICKS(timeout_ms));
+  if (ret == ESP_OK) {
+    spi->in_flight = false;
+  }
+  return ret;
+}
+
+static esp_err_t spi_transport_transmit(led_transport_t *transport,
+                                        const uint8_t *wire, size_t count,
+                                        size_t bytes_per_pixel) {
+  led_transport_spi_t *spi =
+      __containerof(transport, led_transport_spi_t, base);
+  size_t len = count * bytes_per_pixel;
+  size_t frame_size = led_spi_frame_size(spi->bits, len, spi->reset_us);
+  if (frame_size > spi->dma_buffer_size) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  // The DMA buffer is rewritten below, the previous frame must be out
+  esp_err_t ret = spi_transport_wait_done(transport, 500);
+  if (ret != ESP_OK) {
+    ESP_LOGW(TAG, "SPI wait timeout: %s", esp_err_to_name(ret));
+    return ret;
+  }
+
+  led_spi_encode(spi->bits, wire, len, spi->reset_us, spi->dma_buffer);
+  spi->transaction = (spi_transaction_t){
+      .length = frame_size * 8, // in bits
+      .tx_buffer = spi->dma_buffer,
+  };
+  ret = spi_device_queue_trans(spi->device, &spi->transaction, 0);
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "SPI transmit failed: %s", esp_err_to_name(ret));
+    return ret;
+  }
+  spi->in_flight = true;
+  return ESP_OK;
+}
+
+// Releases whatever has been created, also for a partly built transport
+static void spi_transport_release(led_transport_spi_t *spi) {
+  if (spi->device) {
+    spi_bus_remove_device(spi->device);
+  }
+  if (spi->bus_initialized) {
+    spi_bus_free(spi->host);
+  }
+  heap_caps_free(spi->dma_buffer);
+  free(spi);
+}
+
+static esp_err_t spi_transport_del(led_transport_t *transport) {
+  led_transport_spi_t *spi =
+      __containerof(transport, led_transport_spi_t, base);
+  spi_transport_wait_done(transport, 500);
+  spi_transport_release(spi);
+  return ESP_OK;
+}
+
+esp_err_t led_transport_new_spi(const led_transport_spi_config_t *config,
+                                led_transport_t **ret_transport) {
+  esp_err_t ret = ESP_OK;
+  led_transport_spi_t *spi = NULL;
+  ESP_GOTO_ON_FALSE(config && ret_transport && config->max_bytes > 0 &&
+                        (config->bits == LED_SPI_BITS_3 ||
+                         config->bits == LED_SPI_BITS_4),
+                    ESP_ERR_INVALID_ARG, err, TAG, "invalid argument");
+  ESP_GOTO_ON_FALSE(
+      led_transport_supports_chip(LED_TRANSPORT_SPI, config->chip),
+      ESP_ERR_NOT_SUPPORTED, err, TAG, "%s needs the RMT transport",
+      led_timing_get(config->chip)->name);
+  spi = calloc(1, sizeof(led_transport_spi_t));
+  ESP_GOTO_ON_FALSE(spi, ESP_ERR_NO_MEM, err, TAG, "no mem for transport");
+  spi->base.transmit = spi_transport_transmit;
+  spi->base.wait_done = spi_transport_wait_done;
+  spi->base.del = spi_transport_del;
+  spi->host = config->host;
+  spi->bits = config->bits;
+  spi->reset_us =
+      led_timing_reset_us(led_timing_get(config->chip), config->min_reset);
+
+  // The whole frame goes out in one transaction from DMA capable memory
+  spi->dma_buffer_size =
+      led_spi_frame_size(config->bits, config->max_bytes, spi->reset_us);
+  spi->dma_buffer = heap_caps_calloc(1, spi->dma_buffer_size, MALLOC_CAP_DMA);
+  ESP_GOTO_ON_FALSE(spi->dma_buffer, ESP_ERR_NO_MEM, err, TAG,
+                    "no mem for %u byte DMA buffer",
+                    (unsigned)spi->dma_buffer_size);
+
+  // Only MOSI is routed, the clock is not needed by the strip
+  spi_bus_config_t bus_config = {
+      .mosi_io_num = config->gpio,
+      .miso_io_num = -1,
+      .sclk_io_num = -1,
+      .quadwp_io_num = -1,
+      .quadhd_io_num = -1,
+      .max_transfer_sz = spi->dma_buffer_size,
+  };
+  ESP_GOTO_ON_ERROR(
+      spi_bus_initialize(config->host, &bus_config, SPI_DMA_CH_AUTO), err, TAG,
+      "initialize SPI bus failed");
+  spi->bus_initialized = true;
+
+  spi_device_interface_config_t device_config = {
+      .mode = 0,
+      .clock_speed_hz = led_spi_clock_hz(config->bits),
+      .spics_io_num = -1,
+      .queue_size = 1,
+  };
+  ESP_GOTO_ON_ERROR(
+      spi_bus_add_device(config->host, &device_config, &spi->device), err, TAG,
+      "add SPI device failed");
+
+  ESP_LOGI(TAG, "SPI transport on GPIO %d, %d Hz, %u us reset, %u byte DMA",
+           config->gpio, device_config.clock_speed_hz, spi->reset_us,
+           (unsigned)spi->dma_buffer_size);
+  *ret_transport = &spi->base;
+  return ESP_OK;
+
+err:
+  if (spi) {
+    spi_transport_release(spi);
+  }
+  return ret;
+}
@@ -4,12 +4,10 @@
  * SPDX-License-Identifier: Unlicense OR CC0-1.0
  */
 #include "driver/gpio.h"
-#include "driver/rmt_tx.h"
 #include "effect_manager.h"
 #include "esp_log.h"
 #include "freertos/task.h"
 #include "led_effects.h"
-#include "led_strip_encoder.h"
 #include "mdns.h"
 #include "nvs_flash.h"
 #include "spiffs_manager.h"
@@ -25,7 +23,8 @@
 #define RMT_LED_STRIP_RESOLUTION_HZ                                            \
   10000000 // 10MHz resolution, 1 tick = 0.1us (led strip needs a high
            // resolution)
-#define RMT_LED_STRIP_GPIO_NUM 5
+#define LED_STRIP_GPIO_NUM 5
+#define LED_STRIP_SECOND_GPIO_NUM 4 // Second segment of a split strip
 #define CONTROL_BUTTON_GPIO_NUM 2           // SW on Rotate endecoder
 #define CONTROL_BUTTON_SECONDARY_GPIO_NUM 6 // SW on Rotate endecoder
 #define CONTROL_CLK_GPIO_NUM 0
@@ -34,7 +33,6 @@
 
 static const char *TAG = "led_strip";
 
-static uint8_t led_strip_pixels[LED_NUMBERS * 3];
 static effect_manager_t effect_manager;
 
 static TaskHandle_t builtin_led_task_handle = NULL;
@@ -44,6 +42,112 @@ static char saved_password[64] = "";
 
 #define MDNS_HOSTNAME "lamp-01"
 
+// Strip settings, set with POST /api/strip
+static void load_strip_config(led_effect_params_t *params) {
+  nvs_handle_t nvs_handle;
+  uint8_t format = LED_PIXEL_GRB;
+  uint16_t width = LED_DEFAULT_WIDTH;
+  uint16_t height = LED_DEFAULT_HEIGHT;
+  uint8_t layout = 0;
+  uint8_t channels = 1;
+  uint8_t transport = LED_TRANSPORT_RMT;
+  uint8_t chip = LED_CHIP_WS2812B;
+  uint8_t min_reset = 0;
+
+  if (nvs_open(LED_CONFIG_NVS_NAMESPACE, NVS_READONLY, &nvs_handle) ==
+      ESP_OK) {
+    nvs_get_u8(nvs_handle, LED_CONFIG_NVS_PIXEL_FORMAT, &format);
+    nvs_get_u16(nvs_handle, LED_CONFIG_NVS_WIDTH, &width);
+    nvs_get_u16(nvs_handle, LED_CONFIG_NVS_HEIGHT, &height);
+    nvs_get_u8(nvs_handle, LED_CONFIG_NVS_LAYOUT, &layout);
+    nvs_get_u8(nvs_handle, LED_CONFIG_NVS_CHANNELS, &channels);
+    nvs_get_u8(nvs_handle, LED_CONFIG_NVS_TRANSPORT, &transport);
+    nvs_get_u8(nvs_handle, LED_CONFIG_NVS_CHIP, &chip);
+    nvs_get_u8(nvs_handle, LED_CONFIG_NVS_MIN_RESET, &min_reset);
+    nvs_close(nvs_handle);
+  }
+  if (format >= LED_PIXEL_FORMAT_COUNT) {
+    ESP_LOGW(TAG, "Unknown pixel format %u in NVS, using GRB", format);
+    format = LED_PIXEL_GRB;
+  }
+  if (width == 0 || height == 0 || (uint32_t)width * height > LED_MAX_COUNT) {
+    ESP_LOGW(TAG, "Invalid geometry %ux%u in NVS, using %ux%u", width, height,
+             LED_DEFAULT_WIDTH, LED_DEFAULT_HEIGHT);
+    width = LED_DEFAULT_WIDTH;
+    height = LED_DEFAULT_HEIGHT;
+  }
+  if (channels == 0 || channels > LED_MAX_CHANNELS ||
+      channels > (uint32_t)width * height) {
+    ESP_LOGW(TAG, "Invalid channel count %u in NVS, using 1", channels);
+    channels = 1;
+  }
+  if (transport >= LED_TRANSPORT_COUNT) {
+    ESP_LOGW(TAG, "Unknown transport %u in NVS, using RMT", transport);
+    transport = LED_TRANSPORT_RMT;
+  }
+  if (chip >= LED_CHIP_COUNT) {
+    ESP_LOGW(TAG, "Unknown LED chip %u in NVS, using WS2812B", chip);
+    chip = LED_CHIP_WS2812B;
+  }
+  if (!led_transport_supports_chip(transport, chip)) {
+    ESP_LOGW(TAG, "SPI transport cannot drive %s, using RMT",
+             led_timing_get(chip)->name);
+    transport = LED_TRANSPORT_RMT;
+  }
+  if (transport == LED_TRANSPORT_SPI && channels > 1) {
+    // Only one SPI peripheral is free for the strip
+    ESP_LOGW(TAG, "SPI transport drives a single channel");
+    channels = 1;
+  }
+
+  params->pixel_format = (led_pixel_format_t)format;
+  params->geometry.width = width;
+  params->geometry.height = height;
+  params->layout = led_layout_decode(layout);
+  params->channel_count = channels;
+  params->transport_kind = (led_transport_kind_t)transport;
+  params->chip = (led_chip_t)chip;
+  params->min_reset = min_reset != 0;
+  ESP_LOGI(TAG, "LED matrix %ux%u, %s %s, %s with %u channels", width,
+           height, led_timing_get(params->chip)->name,
+           led_pack_format_name(params->pixel_format),
+           led_transport_name(params->transport_kind), channels);
+}
+
+// Custom pixel map uploaded with POST /api/strip/map, replaces the layout
+// Loaded before the render task starts, so the first frame already uses it.
+// Returns NULL without a stored map, the caller frees the map.
+static uint16_t *load_custom_pixel_map(const led_effect_params_t *params) {
+  nvs_handle_t nvs_handle;
+  if (nvs_open(LED_CONFIG_NVS_NAMESPACE, NVS_READONLY, &nvs_handle) !=
+      ESP_OK) {
+    return NULL;
+  }
+
+  size_t size = 0;
+  uint16_t *map = NULL;
+  size_t expected =
+      (size_t)params->geometry.width * params->geometry.height *
+      sizeof(uint16_t);
+  if (nvs_get_blob(nvs_handle, LED_CONFIG_NVS_PIXEL_MAP, NULL, &size) ==
+      ESP_OK) {
+    if (size != expected) {
+      // Stored for another geometry
+      ESP_LOGW(TAG, "Ignoring custom pixel map of %u entries",
+               (unsigned)(size / sizeof(uint16_t)));
+    } else {
+      map = malloc(size);
+      if (map && nvs_get_blob(nvs_handle, LED_CONFIG_NVS_PIXEL_MAP, map,
+                              &size) != ESP_OK) {
+        free(map);
+        map = NULL;
+      }
+    }
+  }
+  nvs_close(nvs_handle);
+  return map;
+}
+
 static esp_err_t init_mdns() {
   esp_err_t err = mdns_init();
   if (err != ESP_OK) {
@@ -205,32 +309,6 @@ void app_main(void) {
   // Initialize SPIFFS
   ESP_LOGI(TAG, "Initializing SPIFFS...");
   ESP_ERROR_CHECK(spiffs_manager_init());
-  ESP_LOGI(TAG, "Create RMT TX channel");
-  rmt_channel_handle_t led_chan = NULL;
-  rmt_tx_channel_config_t tx_chan_config = {
-      .clk_src = RMT_CLK_SRC_DEFAULT, // select source clock
-      .gpio_num = RMT_LED_STRIP_GPIO_NUM,
-      .mem_block_symbols =
-          128, // Увеличиваем размер блока памяти для уменьшения мерцания
-      .resolution_hz = RMT_LED_STRIP_RESOLUTION_HZ,
-      .trans_queue_depth = 8, // Увеличиваем глубину очереди транзакций
-  };
-  ESP_ERROR_CHECK(rmt_new_tx_channel(&tx_chan_config, &led_chan));
-
-  ESP_LOGI(TAG, "Install led strip encoder");
-  rmt_encoder_handle_t led_encoder = NULL;
-  led_strip_encoder_config_t encoder_config = {
-      .resolution = RMT_LED_STRIP_RESOLUTION_HZ,
-  };
-  ESP_ERROR_CHECK(rmt_new_led_strip_encoder(&encoder_config, &led_encoder));
-
-  ESP_LOGI(TAG, "Enable RMT TX channel");
-  ESP_ERROR_CHECK(rmt_enable(led_chan));
-
-  ESP_LOGI(TAG, "Start LED effects");
-  rmt_transmit_config_t tx_config = {
-      .loop_count = 0, // no transfer loop
-  };
 
   // Подготовка параметров для эффектов
   led_effect_params_t *params = malloc(sizeof(led_effect_params_t));
@@ -239,18 +317,47 @@ void app_main(void) {
     return;
   }
 
-  *params =
-      (led_effect_params_t){.led_chan = led_chan,
-                            .led_encoder = led_encoder,
-                            .tx_config = tx_config,
-                            .running = false,
-                            .task_handle = NULL,
-                            .last_task_handle = NULL,
-                            .led_strip_pixels = led_strip_pixels,
-                            .pixel_buffer_size = sizeof(led_strip_pixels)};
+  *params = (led_effect_params_t){.running = false,
+                                  .task_handle = NULL,
+                                  .effect_index = -1,
+                                  .transition_ms = LED_TRANSITION_MS_DEFAULT};
+  load_strip_config(params);
+
+  if (params->transport_kind == LED_TRANSPORT_SPI) {
+    ESP_LOGI(TAG, "Create SPI transport");
+    led_transport_spi_config_t spi_config = {
+        .gpio = LED_STRIP_GPIO_NUM,
+        .host = SPI2_HOST,
+        .bits = LED_SPI_BITS_3,
+        .chip = params->chip,
+        .min_reset = params->min_reset,
+        .max_bytes = (size_t)params->geometry.width * params->geometry.height *
+                     LED_PACK_MAX_BYTES_PER_PIXEL,
+    };
+    ESP_ERROR_CHECK(led_transport_new_spi(&spi_config, &params->transport));
+  } else {
+    ESP_LOGI(TAG, "Create RMT transport");
+    static const gpio_num_t strip_gpios[LED_MAX_CHANNELS] = {
+        LED_STRIP_GPIO_NUM, LED_STRIP_SECOND_GPIO_NUM};
+    led_transport_rmt_config_t rmt_config = {
+        .gpios = strip_gpios,
+        .channel_count = params->channel_count,
+        .resolution_hz = RMT_LED_STRIP_RESOLUTION_HZ,
+        .chip = params->chip,
+        .min_reset = params->min_reset,
+    };
+    ESP_ERROR_CHECK(led_transport_new_rmt(&rmt_config, &params->transport));
+  }
+
+  uint16_t *custom_pixel_map = load_custom_pixel_map(params);
+  params->custom_pixel_map = custom_pixel_map;
+
   // Инициализация менеджера эффектов
   ESP_LOGI(TAG, "Initialize effect manager");
   ESP_ERROR_CHECK(effect_manager_init(&effect_manager, params));
+  // Copied into the render buffers at start
+  params->custom_pixel_map = NULL;
+  free(custom_pixel_map);
 
   ESP_LOGI(TAG, "Current effect: %s",
            effect_manager_get_current_name(&effect_manager));
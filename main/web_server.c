@@ -6,6 +6,7 @@
 #include "cJSON.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "mdns.h"
 #include "nvs.h"
 #include "wifi_manager.h"
@@ -240,6 +241,67 @@ static esp_err_t wifi_config_post_handler(httpd_req_t *req) {
   return ESP_OK;
 }
 
+// Colors travel as "#rrggbb" strings, everything else as numbers
+static void add_param_value(cJSON *json, const char *key,
+                            const effect_param_info_t *param, int32_t value) {
+  if (param->type == EFFECT_PARAM_COLOR) {
+    char color[8];
+    snprintf(color, sizeof(color), "#%06lx", (unsigned long)value);
+    cJSON_AddStringToObject(json, key, color);
+  } else {
+    cJSON_AddNumberToObject(json, key, value);
+  }
+}
+
+// Names of all effects, in index order
+static cJSON *effect_names_to_json(void) {
+  cJSON *names = cJSON_CreateArray();
+  for (int i = 0; i < g_effect_manager->effect_count; i++) {
+    cJSON_AddItemToArray(names,
+                         cJSON_CreateString(g_effect_manager->effects[i].name));
+  }
+  return names;
+}
+
+// Registry entry of an effect with the current values of its parameters
+static cJSON *effect_to_json(int index) {
+  const led_effect_info_t *effect = &g_effect_manager->effects[index];
+  led_effect_params_t *params = g_effect_manager->params;
+
+  cJSON *json = cJSON_CreateObject();
+  cJSON_AddStringToObject(json, "id", effect->id);
+  cJSON_AddStringToObject(json, "name", effect->name);
+  cJSON_AddStringToObject(json, "description", effect->description);
+  cJSON_AddNumberToObject(json, "index", index);
+  cJSON_AddNumberToObject(json, "fps", effect->fps);
+  cJSON_AddNumberToObject(
+      json, "state_size",
+      effect->state_size ? effect->state_size(&params->geometry) : 0);
+
+  cJSON *params_array = cJSON_CreateArray();
+  for (int i = 0; i < effect->param_count; i++) {
+    const effect_param_info_t *param = &effect->params[i];
+    cJSON *item = cJSON_CreateObject();
+    cJSON_AddStringToObject(item, "name", param->name);
+    if (param->type == EFFECT_PARAM_COLOR) {
+      cJSON_AddStringToObject(item, "type", "color");
+    } else {
+      cJSON_AddStringToObject(item, "type", "int");
+      cJSON_AddNumberToObject(item, "min", param->min);
+      cJSON_AddNumberToObject(item, "max", param->max);
+    }
+    add_param_value(item, "default", param, param->def);
+    // Values exist while the render task runs
+    if (params->param_values) {
+      add_param_value(item, "value", param,
+                      led_render_get_param(params, index, i));
+    }
+    cJSON_AddItemToArray(params_array, item);
+  }
+  cJSON_AddItemToObject(json, "params", params_array);
+  return json;
+}
+
 static esp_err_t status_get_handler(httpd_req_t *req) {
   if (g_effect_manager == NULL) {
     httpd_resp_send_500(req);
@@ -261,18 +323,30 @@ static esp_err_t status_get_handler(httpd_req_t *req) {
         SCALE_TO_100(effect_manager_get_brightness(g_effect_manager)));
     cJSON_AddBoolToObject(json, "is_running",
                           g_effect_manager->params->running);
-
-    // Добавляем список доступных эффектов
-    cJSON *effects_array = cJSON_CreateArray();
-    // Создаем массив эффектов из статуса
-    char *effects_copy = strdup(status.effects_list);
-    char *token = strtok(effects_copy, ",");
-    while (token != NULL) {
-      cJSON_AddItemToArray(effects_array, cJSON_CreateString(token));
-      token = strtok(NULL, ",");
-    }
-    free(effects_copy);
-    cJSON_AddItemToObject(json, "available_effects", effects_array);
+    cJSON_AddNumberToObject(json, "dropped_frames",
+                            g_effect_manager->params->clock.dropped_frames);
+    cJSON_AddNumberToObject(json, "skipped_frames",
+                            g_effect_manager->params->skipped_frames);
+    cJSON_AddNumberToObject(json, "transition_ms",
+                            g_effect_manager->params->transition_ms);
+    cJSON_AddStringToObject(
+        json, "pixel_format",
+        led_pack_format_name(g_effect_manager->params->pixel_format));
+    cJSON_AddNumberToObject(json, "width",
+                            g_effect_manager->params->geometry.width);
+    cJSON_AddNumberToObject(json, "height",
+                            g_effect_manager->params->geometry.height);
+    cJSON_AddNumberToObject(json, "channels",
+                            g_effect_manager->params->channel_count);
+    cJSON_AddStringToObject(
+        json, "transport",
+        led_transport_name(g_effect_manager->params->transport_kind));
+    cJSON_AddStringToObject(
+        json, "chip", led_timing_get(g_effect_manager->params->chip)->name);
+    cJSON_AddBoolToObject(json, "min_reset",
+                          g_effect_manager->params->min_reset);
+
+    cJSON_AddItemToObject(json, "available_effects", effect_names_to_json());
   } else {
     cJSON_AddStringToObject(json, "error", "Failed to get status");
   }
@@ -287,6 +361,67 @@ static esp_err_t status_get_handler(httpd_req_t *req) {
   return ESP_OK;
 }
 
+// Timing summary of a histogram: min, avg, percentiles and max in us
+static cJSON *histogram_to_json(const frame_histogram_t *histogram) {
+  cJSON *json = cJSON_CreateObject();
+  cJSON_AddNumberToObject(json, "count", histogram->count);
+  cJSON_AddNumberToObject(json, "min", histogram->min_us);
+  cJSON_AddNumberToObject(json, "avg", frame_histogram_average(histogram));
+  cJSON_AddNumberToObject(json, "p50",
+                          frame_histogram_percentile(histogram, 500));
+  cJSON_AddNumberToObject(json, "p99",
+                          frame_histogram_percentile(histogram, 990));
+  cJSON_AddNumberToObject(json, "max", histogram->max_us);
+  return json;
+}
+
+// HTTP обработчик метрик рендера, ?reset=1 начинает новое окно
+static esp_err_t metrics_get_handler(httpd_req_t *req) {
+  if (g_effect_manager == NULL) {
+    httpd_resp_send_500(req);
+    return ESP_FAIL;
+  }
+  led_effect_params_t *params = g_effect_manager->params;
+
+  // The render task keeps writing, a copy gives one consistent-enough view
+  frame_metrics_t metrics = params->metrics;
+  uint64_t now = esp_timer_get_time();
+
+  cJSON *json = cJSON_CreateObject();
+  cJSON_AddNumberToObject(json, "uptime_ms", now / 1000);
+  cJSON_AddNumberToObject(json, "window_ms", (now - metrics.start_us) / 1000);
+  cJSON_AddNumberToObject(json, "fps",
+                          frame_metrics_fps_x100(&metrics, now) / 100.0);
+  int effect_index = params->effect_index;
+  cJSON_AddNumberToObject(json, "target_fps",
+                          effect_index >= 0
+                              ? params->effects[effect_index].fps
+                              : 0);
+  cJSON_AddNumberToObject(json, "frames", metrics.frames);
+  cJSON_AddNumberToObject(json, "dropped_frames", params->clock.dropped_frames);
+  cJSON_AddNumberToObject(json, "skipped_frames", params->skipped_frames);
+  cJSON_AddItemToObject(json, "render_us", histogram_to_json(&metrics.render));
+  cJSON_AddItemToObject(json, "transmit_us",
+                        histogram_to_json(&metrics.transmit));
+
+  char query[32];
+  char value[8];
+  if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+      httpd_query_key_value(query, "reset", value, sizeof(value)) == ESP_OK &&
+      strcmp(value, "1") == 0) {
+    params->metrics_reset = true;
+  }
+
+  char *json_string = cJSON_Print(json);
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+  httpd_resp_send(req, json_string, strlen(json_string));
+
+  free(json_string);
+  cJSON_Delete(json);
+  return ESP_OK;
+}
+
 // HTTP обработчик для получения списка эффектов
 static esp_err_t effects_list_handler(httpd_req_t *req) {
   if (g_effect_manager == NULL) {
@@ -303,18 +438,13 @@ static esp_err_t effects_list_handler(httpd_req_t *req) {
   }
 
   cJSON *json = cJSON_CreateObject();
-  cJSON *effects_array = cJSON_CreateArray();
-
-  // Парсим список эффектов
-  char *effects_copy = strdup(status.effects_list);
-  char *token = strtok(effects_copy, ",");
-  while (token != NULL) {
-    cJSON_AddItemToArray(effects_array, cJSON_CreateString(token));
-    token = strtok(NULL, ",");
+  cJSON_AddItemToObject(json, "effects", effect_names_to_json());
+  // Весь реестр: описание, частота кадров, схема параметров
+  cJSON *details = cJSON_CreateArray();
+  for (int i = 0; i < g_effect_manager->effect_count; i++) {
+    cJSON_AddItemToArray(details, effect_to_json(i));
   }
-  free(effects_copy);
-
-  cJSON_AddItemToObject(json, "effects", effects_array);
+  cJSON_AddItemToObject(json, "details", details);
   cJSON_AddNumberToObject(json, "total", status.total_effects);
   cJSON_AddNumberToObject(json, "current_index", status.current_effect);
 
@@ -352,16 +482,36 @@ static esp_err_t effect_post_handler(httpd_req_t *req) {
 
   cJSON *effect = cJSON_GetObjectItem(json, "effect");
   cJSON *effect_index = cJSON_GetObjectItem(json, "index");
+  cJSON *transition = cJSON_GetObjectItem(json, "transition_ms");
 
   esp_err_t err = ESP_FAIL;
 
+  // Длительность перехода задается до смены эффекта и может прийти одна
+  if (transition != NULL) {
+    err = ESP_ERR_INVALID_ARG;
+    if (cJSON_IsNumber(transition)) {
+      err = led_render_send(g_effect_manager->params,
+                            LED_COMMAND_SET_TRANSITION, transition->valueint);
+    }
+    if (err != ESP_OK) {
+      httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+      httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST,
+                          "Invalid transition_ms");
+      cJSON_Delete(json);
+      return ESP_OK;
+    }
+  }
+
+  // Команда применяется перед следующим кадром, в ответе эффект из запроса
+  int target = effect_manager_get_current_index(g_effect_manager);
   if (cJSON_IsString(effect)) {
     // Устанавливаем эффект по имени
-    err = effect_manager_set_effect_by_name(g_effect_manager,
-                                            effect->valuestring);
+    target = effect_manager_find_effect(g_effect_manager, effect->valuestring);
+    err = effect_manager_switch_to(g_effect_manager, target);
   } else if (cJSON_IsNumber(effect_index)) {
     // Устанавливаем эффект по индексу
-    err = effect_manager_switch_to(g_effect_manager, effect_index->valueint);
+    target = effect_index->valueint;
+    err = effect_manager_switch_to(g_effect_manager, target);
   }
 
   httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
@@ -369,7 +519,8 @@ static esp_err_t effect_post_handler(httpd_req_t *req) {
     cJSON *response = cJSON_CreateObject();
     cJSON_AddStringToObject(response, "status", "success");
     cJSON_AddStringToObject(response, "current_effect",
-                            effect_manager_get_current_name(g_effect_manager));
+                            target >= 0 ? g_effect_manager->effects[target].name
+                                        : "Unknown");
 
     char *response_string = cJSON_Print(response);
     httpd_resp_set_type(req, "application/json");
@@ -385,6 +536,162 @@ static esp_err_t effect_post_handler(httpd_req_t *req) {
   return ESP_OK;
 }
 
+static bool parse_param_value(const cJSON *item,
+                              const effect_param_info_t *param,
+                              int32_t *value) {
+  if (cJSON_IsNumber(item)) {
+    *value = item->valueint;
+    return true;
+  }
+  if (param->type == EFFECT_PARAM_COLOR && cJSON_IsString(item) &&
+      item->valuestring[0] == '#' && strlen(item->valuestring) == 7) {
+    char *end;
+    *value = (int32_t)strtol(&item->valuestring[1], &end, 16);
+    return *end == '\0';
+  }
+  return false;
+}
+
+// Effect of a request: ?index=N or ?effect=<id or name>, else current.
+// False for an index that is not a number or out of range; an unknown name
+// gives -1.
+static bool param_request_effect(httpd_req_t *req, int *index) {
+  char query[64];
+  char value[32];
+  if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+    if (httpd_query_key_value(query, "index", value, sizeof(value)) == ESP_OK) {
+      char *end;
+      long number = strtol(value, &end, 10);
+      if (end == value || *end != '\0' || number < 0 ||
+          number >= g_effect_manager->effect_count) {
+        return false;
+      }
+      *index = (int)number;
+      return true;
+    }
+    if (httpd_query_key_value(query, "effect", value, sizeof(value)) ==
+        ESP_OK) {
+      *index = effect_manager_find_effect(g_effect_manager, value);
+      return true;
+    }
+  }
+  *index = effect_manager_get_current_index(g_effect_manager);
+  return true;
+}
+
+// HTTP обработчик параметров эффекта: схема и текущие значения
+static esp_err_t effect_params_get_handler(httpd_req_t *req) {
+  if (g_effect_manager == NULL) {
+    httpd_resp_send_500(req);
+    return ESP_FAIL;
+  }
+
+  int index;
+  httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+  if (!param_request_effect(req, &index)) {
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid effect index");
+    return ESP_OK;
+  }
+  if (index < 0 || index >= g_effect_manager->effect_count) {
+    httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Unknown effect");
+    return ESP_OK;
+  }
+
+  cJSON *json = effect_to_json(index);
+  char *json_string = cJSON_Print(json);
+  httpd_resp_set_type(req, "application/json");
+  httpd_resp_send(req, json_string, strlen(json_string));
+
+  free(json_string);
+  cJSON_Delete(json);
+  return ESP_OK;
+}
+
+// HTTP обработчик изменения параметров:
+// {"effect": "Fire", "params": {"cooling": 8, "sparks": 6}}
+// Без effect меняются параметры текущего эффекта. Значения сохраняются в
+// NVS вместе с яркостью и переживают перезагрузку
+static esp_err_t effect_params_post_handler(httpd_req_t *req) {
+  if (g_effect_manager == NULL) {
+    httpd_resp_send_500(req);
+    return ESP_FAIL;
+  }
+
+  char buf[256];
+  int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
+  if (ret <= 0) {
+    httpd_resp_send_500(req);
+    return ESP_FAIL;
+  }
+  buf[ret] = '\0';
+
+  httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+  cJSON *json = cJSON_Parse(buf);
+  if (json == NULL) {
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+    return ESP_FAIL;
+  }
+
+  cJSON *effect = cJSON_GetObjectItem(json, "effect");
+  cJSON *values = cJSON_GetObjectItem(json, "params");
+  int index = cJSON_IsString(effect)
+                  ? effect_manager_find_effect(g_effect_manager,
+                                               effect->valuestring)
+                  : effect_manager_get_current_index(g_effect_manager);
+  if (index < 0 || !cJSON_IsObject(values)) {
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST,
+                        "Invalid effect or params");
+    cJSON_Delete(json);
+    return ESP_OK;
+  }
+
+  // Проверяем все значения до применения: ошибка не меняет ничего
+  const led_effect_info_t *info = &g_effect_manager->effects[index];
+  int32_t requested[EFFECT_MAX_PARAMS];
+  bool given[EFFECT_MAX_PARAMS] = {false};
+  const char *failed = NULL;
+  cJSON *item;
+  cJSON_ArrayForEach(item, values) {
+    int param =
+        effect_manager_find_param(g_effect_manager, index, item->string);
+    int32_t value;
+    if (param < 0 || !parse_param_value(item, &info->params[param], &value) ||
+        value < info->params[param].min || value > info->params[param].max) {
+      failed = item->string;
+      break;
+    }
+    requested[param] = value;
+    given[param] = true;
+  }
+  for (int i = 0; !failed && i < info->param_count; i++) {
+    if (given[i] &&
+        effect_manager_set_param(g_effect_manager, index,
+                                 info->params[i].name,
+                                 requested[i]) != ESP_OK) {
+      failed = info->params[i].name;
+    }
+  }
+
+  if (failed) {
+    char message[64];
+    snprintf(message, sizeof(message), "Invalid parameter %s", failed);
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, message);
+  } else {
+    cJSON *response = cJSON_CreateObject();
+    cJSON_AddStringToObject(response, "status", "success");
+    cJSON_AddStringToObject(response, "effect", info->name);
+
+    char *response_string = cJSON_Print(response);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, response_string, strlen(response_string));
+    free(response_string);
+    cJSON_Delete(response);
+  }
+
+  cJSON_Delete(json);
+  return ESP_OK;
+}
+
 // HTTP обработчик для переключения на следующий эффект
 static esp_err_t next_effect_handler(httpd_req_t *req) {
   if (g_effect_manager == NULL) {
@@ -392,6 +699,10 @@ static esp_err_t next_effect_handler(httpd_req_t *req) {
     return ESP_FAIL;
   }
 
+  // Ответ предсказывает результат: команда применяется перед следующим
+  // кадром, если ее не обгонит другая
+  int target = (effect_manager_get_current_index(g_effect_manager) + 1) %
+               g_effect_manager->effect_count;
   esp_err_t err = effect_manager_switch_next(g_effect_manager);
 
   httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
@@ -399,9 +710,8 @@ static esp_err_t next_effect_handler(httpd_req_t *req) {
     cJSON *response = cJSON_CreateObject();
     cJSON_AddStringToObject(response, "status", "success");
     cJSON_AddStringToObject(response, "current_effect",
-                            effect_manager_get_current_name(g_effect_manager));
-    cJSON_AddNumberToObject(response, "current_index",
-                            effect_manager_get_current_index(g_effect_manager));
+                            g_effect_manager->effects[target].name);
+    cJSON_AddNumberToObject(response, "current_index", target);
 
     char *response_string = cJSON_Print(response);
     httpd_resp_set_type(req, "application/json");
@@ -416,6 +726,263 @@ static esp_err_t next_effect_handler(httpd_req_t *req) {
   return ESP_OK;
 }
 
+// HTTP обработчик настроек ленты
+// Strip settings: {"pixel_format": "GRB" | "RGB" | "BGR" | "GRBW",
+// "width": 16, "height": 16, "serpentine": true, "rotation": 90,
+// "flip_x": false, "flip_y": false, "channels": 2, "transport": "rmt" |
+// "spi", "chip": "WS2812B" | "WS2811" | "SK6812" | "WS2815", "min_reset":
+// false}, every field is optional; "spi" drives WS2812B only. Format and
+// layout apply at once, the geometry, channels, transport and chip timing
+// after a restart.
+static esp_err_t strip_post_handler(httpd_req_t *req) {
+  if (g_effect_manager == NULL) {
+    httpd_resp_send_500(req);
+    return ESP_FAIL;
+  }
+
+  char buf[200];
+  int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
+  if (ret <= 0) {
+    httpd_resp_send_500(req);
+    return ESP_FAIL;
+  }
+  buf[ret] = '\0';
+
+  cJSON *json = cJSON_Parse(buf);
+  if (json == NULL) {
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+    return ESP_FAIL;
+  }
+
+  led_effect_params_t *params = g_effect_manager->params;
+  cJSON *pixel_format = cJSON_GetObjectItem(json, "pixel_format");
+  cJSON *width = cJSON_GetObjectItem(json, "width");
+  cJSON *height = cJSON_GetObjectItem(json, "height");
+  cJSON *serpentine = cJSON_GetObjectItem(json, "serpentine");
+  cJSON *rotation = cJSON_GetObjectItem(json, "rotation");
+  cJSON *flip_x = cJSON_GetObjectItem(json, "flip_x");
+  cJSON *flip_y = cJSON_GetObjectItem(json, "flip_y");
+  cJSON *channels = cJSON_GetObjectItem(json, "channels");
+  cJSON *transport = cJSON_GetObjectItem(json, "transport");
+  cJSON *chip = cJSON_GetObjectItem(json, "chip");
+  cJSON *min_reset = cJSON_GetObjectItem(json, "min_reset");
+  led_chip_t chip_kind = params->chip;
+  led_transport_kind_t transport_kind = params->transport_kind;
+  led_pixel_format_t format = params->pixel_format;
+  led_layout_t layout = params->layout;
+  bool has_geometry = width || height;
+  bool has_layout = serpentine || rotation || flip_x || flip_y;
+  bool restart_required =
+      has_geometry || channels || transport || chip || min_reset;
+  bool valid = pixel_format || has_layout || restart_required;
+
+  // Проверяем все поля до применения
+  if (pixel_format &&
+      !(cJSON_IsString(pixel_format) &&
+        led_pack_format_from_name(pixel_format->valuestring, &format))) {
+    valid = false;
+  }
+  // Both sides come together. Each is bounded first, so the product
+  // cannot overflow.
+  if (has_geometry &&
+      !(cJSON_IsNumber(width) && cJSON_IsNumber(height) &&
+        width->valueint >= 1 && height->valueint >= 1 &&
+        width->valueint <= LED_MAX_COUNT && height->valueint <= LED_MAX_COUNT &&
+        width->valueint * height->valueint <= LED_MAX_COUNT)) {
+    valid = false;
+  }
+  if (channels && !(cJSON_IsNumber(channels) && channels->valueint >= 1 &&
+                    channels->valueint <= LED_MAX_CHANNELS)) {
+    valid = false;
+  }
+  if (transport &&
+      !(cJSON_IsString(transport) &&
+        led_transport_from_name(transport->valuestring, &transport_kind))) {
+    valid = false;
+  }
+  if (chip && !(cJSON_IsString(chip) &&
+                led_timing_from_name(chip->valuestring, &chip_kind))) {
+    valid = false;
+  }
+  if (min_reset && !cJSON_IsBool(min_reset)) {
+    valid = false;
+  }
+  // Transport and chip are checked together, either may come alone
+  if (!led_transport_supports_chip(transport_kind, chip_kind)) {
+    valid = false;
+  }
+  if (cJSON_IsBool(serpentine)) {
+    layout.serpentine = cJSON_IsTrue(serpentine);
+  }
+  if (cJSON_IsNumber(rotation)) {
+    layout.rotation = rotation->valueint;
+    if (rotation->valueint < 0 || rotation->valueint % 90 != 0 ||
+        rotation->valueint >= 360) {
+      valid = false;
+    }
+  }
+  if (cJSON_IsBool(flip_x)) {
+    layout.flip_x = cJSON_IsTrue(flip_x);
+  }
+  if (cJSON_IsBool(flip_y)) {
+    layout.flip_y = cJSON_IsTrue(flip_y);
+  }
+
+  esp_err_t err = valid ? ESP_OK : ESP_ERR_INVALID_ARG;
+  if (err == ESP_OK && pixel_format) {
+    err = led_render_set_pixel_format(params, format);
+  }
+  if (err == ESP_OK && has_layout) {
+    err = led_render_set_layout(params, &layout);
+  }
+
+  httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+  if (err == ESP_OK) {
+    // Сохраняем настройки в NVS, чтобы они применялись после перезагрузки
+    nvs_handle_t nvs_handle;
+    if (nvs_open(LED_CONFIG_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) ==
+        ESP_OK) {
+      nvs_set_u8(nvs_handle, LED_CONFIG_NVS_PIXEL_FORMAT, format);
+      if (has_geometry) {
+        nvs_set_u16(nvs_handle, LED_CONFIG_NVS_WIDTH, width->valueint);
+        nvs_set_u16(nvs_handle, LED_CONFIG_NVS_HEIGHT, height->valueint);
+      }
+      if (channels) {
+        nvs_set_u8(nvs_handle, LED_CONFIG_NVS_CHANNELS, channels->valueint);
+      }
+      if (transport) {
+        nvs_set_u8(nvs_handle, LED_CONFIG_NVS_TRANSPORT, transport_kind);
+      }
+      if (chip) {
+        nvs_set_u8(nvs_handle, LED_CONFIG_NVS_CHIP, chip_kind);
+      }
+      if (min_reset) {
+        nvs_set_u8(nvs_handle, LED_CONFIG_NVS_MIN_RESET,
+                   cJSON_IsTrue(min_reset));
+      }
+      if (has_layout) {
+        // Раскладка заменяет загруженную карту пикселей
+        nvs_set_u8(nvs_handle, LED_CONFIG_NVS_LAYOUT,
+                   led_layout_encode(&layout));
+        nvs_erase_key(nvs_handle, LED_CONFIG_NVS_PIXEL_MAP);
+      }
+      nvs_commit(nvs_handle);
+      nvs_close(nvs_handle);
+    } else {
+      ESP_LOGW(TAG, "Failed to save strip settings");
+    }
+
+    cJSON *response = cJSON_CreateObject();
+    cJSON_AddStringToObject(response, "status", "success");
+    cJSON_AddStringToObject(response, "pixel_format",
+                            led_pack_format_name(format));
+    cJSON_AddBoolToObject(response, "restart_required", restart_required);
+
+    char *response_string = cJSON_Print(response);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, response_string, strlen(response_string));
+    free(response_string);
+    cJSON_Delete(response);
+  } else {
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST,
+                        "Invalid strip settings");
+  }
+
+  cJSON_Delete(json);
+  return ESP_OK;
+}
+
+// Custom pixel map: JSON array with the strip position of every LED, row by
+// row as the effects draw them, e.g. [0, 1, 2, 3, 7, 6, 5, 4]
+static esp_err_t strip_map_post_handler(httpd_req_t *req) {
+  if (g_effect_manager == NULL) {
+    httpd_resp_send_500(req);
+    return ESP_FAIL;
+  }
+
+  // До 1024 чисел, тело не помещается в буфер на стеке
+  size_t body_len = req->content_len;
+  if (body_len == 0 || body_len > LED_MAX_COUNT * 6 + 16) {
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid map size");
+    return ESP_FAIL;
+  }
+  char *buf = malloc(body_len + 1);
+  if (buf == NULL) {
+    httpd_resp_send_500(req);
+    return ESP_FAIL;
+  }
+  size_t received = 0;
+  while (received < body_len) {
+    int ret = httpd_req_recv(req, buf + received, body_len - received);
+    if (ret <= 0) {
+      free(buf);
+      httpd_resp_send_500(req);
+      return ESP_FAIL;
+    }
+    received += ret;
+  }
+  buf[received] = '\0';
+
+  cJSON *json = cJSON_Parse(buf);
+  free(buf);
+  if (!cJSON_IsArray(json)) {
+    cJSON_Delete(json);
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+    return ESP_FAIL;
+  }
+
+  led_effect_params_t *params = g_effect_manager->params;
+  int count = cJSON_GetArraySize(json);
+  uint16_t *map = malloc(count * sizeof(uint16_t) + 1);
+  esp_err_t err = map ? ESP_OK : ESP_ERR_NO_MEM;
+  for (int i = 0; err == ESP_OK && i < count; i++) {
+    cJSON *item = cJSON_GetArrayItem(json, i);
+    if (!cJSON_IsNumber(item) || item->valueint < 0 ||
+        item->valueint >= count) {
+      err = ESP_ERR_INVALID_ARG;
+    } else {
+      map[i] = item->valueint;
+    }
+  }
+  cJSON_Delete(json);
+  if (err == ESP_OK) {
+    err = led_render_set_pixel_map(params, map, count);
+  }
+
+  httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+  if (err == ESP_OK) {
+    nvs_handle_t nvs_handle;
+    if (nvs_open(LED_CONFIG_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) ==
+        ESP_OK) {
+      nvs_set_blob(nvs_handle, LED_CONFIG_NVS_PIXEL_MAP, map,
+                   count * sizeof(uint16_t));
+      nvs_commit(nvs_handle);
+      nvs_close(nvs_handle);
+    } else {
+      ESP_LOGW(TAG, "Failed to save pixel map");
+    }
+
+    cJSON *response = cJSON_CreateObject();
+    cJSON_AddStringToObject(response, "status", "success");
+    cJSON_AddNumberToObject(response, "count", count);
+
+    char *response_string = cJSON_Print(response);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, response_string, strlen(response_string));
+    free(response_string);
+    cJSON_Delete(response);
+  } else {
+    httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST,
+                        "Map must list every LED position exactly once");
+  }
+
+  free(map);
+  return ESP_OK;
+}
+
 // HTTP обработчик для изменения яркости
 static esp_err_t brightness_post_handler(httpd_req_t *req) {
   if (g_effect_manager == NULL) {
@@ -457,8 +1024,11 @@ static esp_err_t brightness_post_handler(httpd_req_t *req) {
   } else if (cJSON_IsNumber(delta)) {
     // Изменяем яркость на delta
     int8_t delta_value = (int8_t)delta->valueint;
+    // Команда применяется перед следующим кадром, ответ ее предсказывает
+    int predicted = effect_manager_get_brightness(g_effect_manager) +
+                    delta_value;
+    new_brightness = predicted < 1 ? 1 : predicted > 255 ? 255 : predicted;
     err = effect_manager_adjust_brightness(g_effect_manager, delta_value);
-    new_brightness = effect_manager_get_brightness(g_effect_manager);
   }
 
   httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
@@ -506,21 +1076,20 @@ static esp_err_t power_post_handler(httpd_req_t *req) {
   cJSON *power = cJSON_GetObjectItem(json, "power");
   if (cJSON_IsBool(power)) {
     if (cJSON_IsTrue(power)) {
-      // Включаем эффекты - устанавливаем флаг running в true
-      g_effect_manager->params->running = true;
+      // Включаем эффекты
       effect_manager_start_current(g_effect_manager);
       ESP_LOGI(TAG, "Effects enabled via web API");
     } else {
       // Выключаем эффекты - останавливаем текущий эффект
-      g_effect_manager->params->running = false;
       effect_manager_stop_current(g_effect_manager);
       ESP_LOGI(TAG, "Effects disabled via web API");
     }
 
+    // Команда применяется перед следующим кадром, в ответе запрошенное
     httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
     cJSON *response = cJSON_CreateObject();
     cJSON_AddStringToObject(response, "status", "success");
-    cJSON_AddBoolToObject(response, "power", g_effect_manager->params->running);
+    cJSON_AddBoolToObject(response, "power", cJSON_IsTrue(power));
 
     char *response_string = cJSON_Print(response);
     httpd_resp_set_type(req, "application/json");
@@ -849,6 +1418,12 @@ esp_err_t web_server_init(effect_manager_t *effect_mgr) {
                             .user_ctx = NULL};
   httpd_register_uri_handler(server, &status_uri);
 
+  httpd_uri_t metrics_uri = {.uri = "/api/metrics",
+                             .method = HTTP_GET,
+                             .handler = metrics_get_handler,
+                             .user_ctx = NULL};
+  httpd_register_uri_handler(server, &metrics_uri);
+
   httpd_uri_t effects_uri = {.uri = "/api/effects",
                              .method = HTTP_GET,
                              .handler = effects_list_handler,
@@ -861,6 +1436,18 @@ esp_err_t web_server_init(effect_manager_t *effect_mgr) {
                             .user_ctx = NULL};
   httpd_register_uri_handler(server, &effect_uri);
 
+  httpd_uri_t effect_params_uri = {.uri = "/api/effect/params",
+                                   .method = HTTP_GET,
+                                   .handler = effect_params_get_handler,
+                                   .user_ctx = NULL};
+  httpd_register_uri_handler(server, &effect_params_uri);
+
+  httpd_uri_t effect_params_post_uri = {.uri = "/api/effect/params",
+                                        .method = HTTP_POST,
+                                        .handler = effect_params_post_handler,
+                                        .user_ctx = NULL};
+  httpd_register_uri_handler(server, &effect_params_post_uri);
+
   httpd_uri_t next_effect_uri = {.uri = "/api/effect/next",
                                  .method = HTTP_POST,
                                  .handler = next_effect_handler,
@@ -873,6 +1460,18 @@ esp_err_t web_server_init(effect_manager_t *effect_mgr) {
                                 .user_ctx = NULL};
   httpd_register_uri_handler(server, &brightness_uri);
 
+  httpd_uri_t strip_uri = {.uri = "/api/strip",
+                           .method = HTTP_POST,
+                           .handler = strip_post_handler,
+                           .user_ctx = NULL};
+  httpd_register_uri_handler(server, &strip_uri);
+
+  httpd_uri_t strip_map_uri = {.uri = "/api/strip/map",
+                               .method = HTTP_POST,
+                               .handler = strip_map_post_handler,
+                               .user_ctx = NULL};
+  httpd_register_uri_handler(server, &strip_map_uri);
+
   httpd_uri_t power_uri = {.uri = "/api/power",
                            .method = HTTP_POST,
                            .handler = power_post_handler,
@@ -906,11 +1505,16 @@ esp_err_t web_server_init(effect_manager_t *effect_mgr) {
   ESP_LOGI(TAG, "Web interface available at: http://[IP_ADDRESS]/");
   ESP_LOGI(TAG, "API endpoints available:");
   ESP_LOGI(TAG, "  GET  /api/status");
+  ESP_LOGI(TAG, "  GET  /api/metrics");
   ESP_LOGI(TAG, "  GET  /api/effects");
   ESP_LOGI(TAG, "  POST /api/effect");
   ESP_LOGI(TAG, "  POST /api/effect/next");
+  ESP_LOGI(TAG, "  GET  /api/effect/params");
+  ESP_LOGI(TAG, "  POST /api/effect/params");
   ESP_LOGI(TAG, "  POST /api/brightness");
   ESP_LOGI(TAG, "  POST /api/power");
+  ESP_LOGI(TAG, "  POST /api/strip");
+  ESP_LOGI(TAG, "  POST /api/strip/map");
 
   return ESP_OK;
 }